@@ -33,6 +33,7 @@ Written for NodeMCU 1.0 ESP-12E board
 String MESH_SSID = "whateverYouLike";
 String MESH_PSWD = "somethingSneaky";
 uint16_t MESH_PORT = 5555;
+int MESH_GROUP = 0;			// MESH_GROUP is None
 
 int DHTTYP = 0;		    // DHT attached to None
 int DHTPIN = 99;		// DHT attached at None
@@ -33,6 +33,7 @@ Written for NodeMCU 1.0 ESP-12E board
 String MESH_SSID = "whateverYouLike";
 String MESH_PSWD = "somethingSneaky";
 uint16_t MESH_PORT = 5555;
+int MESH_GROUP = 0;			// MESH_GROUP is None
 
 int DHTTYP = 11;		// DHT attached to DHT11 Sensor
 int DHTPIN = 5;			// DHT attached at Pin D1 (GPIO5)
@@ -46,6 +47,10 @@ int FLMPIN = 99;		// FLM attached at None
 bool PINGER = false;	//PINGER attached = false
 int PINGERPIN = 99;		//PINGER attached at None
 
+uint32_t REPORTINTERVAL = 2000;	// Sensors checked every 2 seconds
+float TEMTHRESHOLD = 50.0;		// TEM alarm at 50 C
+int GASTHRESHOLD = 0;		// GAS threshold disabled
+
 int CONNECTLEDPIN = 16;         // CONNECTLEDPIN attached at Pin D0 (LED_BUILTIN)
 uint32_t SERIALBAUD = 115200;    // SERIALBAUD rate is 38400 bps
 
@@ -33,6 +33,7 @@ Written for NodeMCU 1.0 ESP-12E board
 String MESH_SSID = "whateverYouLike";
 String MESH_PSWD = "somethingSneaky";
 uint16_t MESH_PORT = 5555;
+int MESH_GROUP = 0;			// MESH_GROUP is None
 
 int DHTTYP = 0;		    // DHT attached to None
 int DHTPIN = 99;		// DHT attached at None
@@ -46,6 +47,10 @@ int FLMPIN = 5;		    // FLM attached at Pin D1 (GPIO5)
 bool PINGER = false;	//PINGER attached = false
 int PINGERPIN = 99;		//PINGER attached at None
 
+uint32_t REPORTINTERVAL = 1000;	// Sensors checked every second
+float TEMTHRESHOLD = 0;		// TEM threshold disabled
+int GASTHRESHOLD = 400;		// GAS alarm at 400
+
 int CONNECTLEDPIN = 16;         // CONNECTLEDPIN attached at Pin D0 (LED_BUILTIN)
 uint32_t SERIALBAUD = 115200;   // SERIALBAUD rate is 115200 bps
 
@@ -37,631 +37,4219 @@ SOFTWARE.
 extern String MESH_SSID;
 extern String MESH_PSWD;
 extern uint16_t MESH_PORT;
-// Node Sensor Hardware Configuration Values
+// Node Multicast Group Configuration Value. Defined weakly as no group, so sketches that do not define it still link.
+__attribute__((weak)) int MESH_GROUP = 0;
+/*
+Node Sensor and Button Hardware Configuration Values. The sensor types and the PINGER flag can be 
+fixed with build flags (such as -DCONFIG_DHTTYP=22), in which case the value of the sketch is 
+ignored and the checks for the hardware are resolved at compile time.
+*/
+#ifdef CONFIG_DHTTYP
+const int DHTTYP = CONFIG_DHTTYP;
+#else
 extern int DHTTYP;
+#endif
 extern int DHTPIN;
+#ifdef CONFIG_GASTYP
+const int GASTYP = CONFIG_GASTYP;
+#else
 extern int GASTYP;
+#endif
 extern int GASPIN;
+#ifdef CONFIG_FLMTYP
+const int FLMTYP = CONFIG_FLMTYP;
+#else
 extern int FLMTYP;
+#endif
 extern int FLMPIN;
-// Node Button Hardware Configuration Values
+#ifdef CONFIG_PINGER
+const bool PINGER = CONFIG_PINGER;
+#else
 extern bool PINGER;
+#endif
 extern int PINGERPIN;
+/*
+Node Sensor Reporting Configuration Values. They are defined weakly with defaults that disable push 
+reporting, so sketches that do not define them still link. A sketch overrides a value by defining it.
+*/
+__attribute__((weak)) uint32_t REPORTINTERVAL = 0;
+__attribute__((weak)) float TEMTHRESHOLD = 0;
+__attribute__((weak)) int GASTHRESHOLD = 0;
+__attribute__((weak)) uint32_t REPORT_HEARTBEAT = 60000;
+__attribute__((weak)) float REPORT_HUMDELTA = 5.0;
+__attribute__((weak)) float REPORT_TEMDELTA = 1.0;
+__attribute__((weak)) int REPORT_GASDELTA = 50;
 // Node Serial Interface Configuration Value
 extern uint32_t SERIALBAUD;
 // Node Connection LED Configuration Value
 extern int CONNECTLEDPIN;
 
+/*
+Driver Configuration Values. A driver set to false is compiled out of the library along with its 
+runtimes and objects. They can be overridden with build flags (such as -DSENSORDRIVER_DHT=false) 
+for nodes that are known not to have the hardware when they are flashed, and default to false 
+for hardware that is fixed as not attached with a CONFIG_ build flag.
+*/
+#ifndef SENSORDRIVER_DHT
+#if defined(CONFIG_DHTTYP) && CONFIG_DHTTYP == 0
+#define SENSORDRIVER_DHT false
+#else
+#define SENSORDRIVER_DHT true
+#endif
+#endif
+#ifndef SENSORDRIVER_GAS
+#if defined(CONFIG_GASTYP) && CONFIG_GASTYP == 0
+#define SENSORDRIVER_GAS false
+#else
+#define SENSORDRIVER_GAS true
+#endif
+#endif
+#ifndef SENSORDRIVER_FLM
+#if defined(CONFIG_FLMTYP) && CONFIG_FLMTYP == 0
+#define SENSORDRIVER_FLM false
+#else
+#define SENSORDRIVER_FLM true
+#endif
+#endif
+#ifndef BUTTONDRIVER_PINGER
+#if defined(CONFIG_PINGER) && !CONFIG_PINGER
+#define BUTTONDRIVER_PINGER false
+#else
+#define BUTTONDRIVER_PINGER true
+#endif
+#endif
+// Loop Profiler Configuration Value. The profiler instrumentation of update() is compiled out when false.
+#ifndef LOOPPROFILER
+#define LOOPPROFILER true
+#endif
+
+// Macros that check if a sensor or button is attached to the node and its driver is compiled in.
+#define DHTATTACHED (SENSORDRIVER_DHT && DHTTYP > 0)
+#define GASATTACHED (SENSORDRIVER_GAS && GASTYP > 0)
+#define FLMATTACHED (SENSORDRIVER_FLM && FLMTYP > 0)
+#define PINGERATTACHED (BUTTONDRIVER_PINGER && PINGER == true)
+
 // Global Runtime Variables
-uint32_t handshaketimer = 0;
 uint32_t MESHCONTROLNODE = 0;
 bool MESHCONNECTED = false;
 
 // Global Runtime Objects
 painlessMesh mesh;
 Scheduler meshScheduler;
+#if SENSORDRIVER_DHT
 DHT dht(DHTPIN, DHTTYP);
+#endif
+#if BUTTONDRIVER_PINGER
 Button pingerButton(PINGERPIN);
+#endif
+
+// Handshake Scheduler Configuration Values
+#define HANDSHAKE_STARTDELAY 2000
+#define HANDSHAKE_MININTERVAL 2000
+#define HANDSHAKE_MAXINTERVAL 60000
+#define CONNECTIONCHECK_INTERVAL 1000
+
+// The current handshake backoff interval (ms)
+uint32_t HANDSHAKEINTERVAL = HANDSHAKE_MININTERVAL;
+// The configuration hash of the node, computed once at startup
+uint32_t CONFIGHASH = 0;
+
+void runhandshake();
+void checkmeshconnection();
+void runsensorsampling();
+void runsensorreport();
+void runsensorhistory();
+void runhistoryreply();
+void checkpingtracker();
+void retransmitreliable();
+void flushconnectionupdate();
+void flushmeshsync();
+void runfanout();
+void runconfigreply();
+void runtrafficreport();
+
+// Scheduler tasks for the handshake runtime and the control node connection check
+Task handshaketask(HANDSHAKE_MININTERVAL, TASK_FOREVER, &runhandshake);
+Task connectiontask(CONNECTIONCHECK_INTERVAL, TASK_FOREVER, &checkmeshconnection);
+Task sampletask(TASK_SECOND, TASK_FOREVER, &runsensorsampling);
+Task reporttask(TASK_SECOND, TASK_FOREVER, &runsensorreport);
+Task historytask(TASK_SECOND, TASK_FOREVER, &runsensorhistory);
+Task historyreplytask(TASK_SECOND, TASK_FOREVER, &runhistoryreply);
+Task trackertask(TASK_SECOND, TASK_FOREVER, &checkpingtracker);
+Task reliabletask(TASK_SECOND, TASK_FOREVER, &retransmitreliable);
+Task connectionupdatetask(TASK_SECOND, TASK_ONCE, &flushconnectionupdate);
+Task meshsynctask(TASK_SECOND, TASK_ONCE, &flushmeshsync);
+Task fanouttask(TASK_SECOND, TASK_FOREVER, &runfanout);
+Task configreplytask(TASK_SECOND, TASK_FOREVER, &runconfigreply);
+Task traffictask(TASK_SECOND, TASK_FOREVER, &runtrafficreport);
+
+// IMC Wire Format Values
+#define IMC_WIREVERSION 1
+#define IMC_HEADERSIZE 11
+#define IMC_MAXPING 31
+#define IMC_MAXFRAME 192
+#define IMC_MAXENCODED (((IMC_MAXFRAME + 2) / 3) * 4)
+
+// IMC Message Types
+enum imcmessagetype : uint8_t {
+    IMC_UNKNOWN = 0,
+    IMC_MESHCOMMAND = 1,
+    IMC_HANDSHAKE = 2,
+    IMC_HANDSHAKEACK = 3,
+    IMC_SENSORDATA = 4,
+    IMC_CONFIGDATA = 5,
+    IMC_CONNECTIONUPDATE = 6,
+    IMC_HISTORYDATA = 7,
+    IMC_ACK = 8,
+    IMC_PROFILEDATA = 9,
+    IMC_NODEMETRICS = 10
+};
+
+// IMC Reach Types
+enum imcreachtype : uint8_t {
+    IMC_UNICAST = 1,
+    IMC_BROADCAST = 2,
+    IMC_MULTICAST = 3
+};
+
+// IMC Field Kinds
+enum imcfieldkind : uint8_t {
+    IMC_KIND_U8 = 0,
+    IMC_KIND_BOOL = 1,
+    IMC_KIND_U16 = 2,
+    IMC_KIND_U32 = 3,
+    IMC_KIND_F32 = 4,
+    IMC_KIND_BYTES = 5
+};
+
+// IMC Command Codes for 'meshcommand' messages
+enum imccommand : uint8_t {
+    IMC_COMMAND_NONE = 0,
+    IMC_COMMAND_READSENSORS = 1,
+    IMC_COMMAND_READCONFIG = 2,
+    IMC_COMMAND_READHISTORY = 3,
+    IMC_COMMAND_READPROFILE = 4,
+    IMC_COMMAND_READTRAFFIC = 5
+};
+
+// IMC Update Codes for 'connectionupdate' messages
+enum imcupdatetype : uint8_t {
+    IMC_UPDATE_NONE = 0,
+    IMC_UPDATE_NEWCONNECTION = 1,
+    IMC_UPDATE_CHANGEDCONNECTION = 2
+};
+
+// IMC Field IDs for 'meshcommand', 'handshake', 'handshakeACK' and 'connectionupdate' messages
+#define IMC_FIELD_COMMAND 1
+#define IMC_FIELD_GROUP 1
+#define IMC_FIELD_CONTROLNODE 1
+#define IMC_FIELD_UPDATETYPE 1
+#define IMC_FIELD_SINCE 2
+
+// IMC Field IDs for the change counts of 'connectionupdate' messages
+#define IMC_FIELD_NEWCOUNT 2
+#define IMC_FIELD_CHANGEDCOUNT 3
+
+// IMC Field ID reserved in every message type for the sequence number of reliable unicast messages and acks
+#define IMC_FIELD_SEQUENCE 31
+// IMC Field ID reserved in every message type for the configuration hash of the sending node
+#define IMC_FIELD_CONFIGHASH 30
+
+// IMC Field IDs for 'historydata' messages
+#define IMC_HISTORY_CHUNK 1
+#define IMC_HISTORY_LAST 2
+#define IMC_HISTORY_SAMPLES 3
+
+// IMC Field IDs for 'profiledata' messages. Every stage is a bytes field of [stage:u8][min:u32][avg:u32][max:u32][p99:u32].
+#define IMC_PROFILE_STAGE 1
+#define IMC_PROFILE_FREQUENCY 2
+#define IMC_PROFILE_FREEHEAP 3
+#define IMC_PROFILE_HEAPLOWWATER 4
+#define IMC_PROFILE_STALL 5
+#define IMC_PROFILE_STALLAGE 6
+#define IMC_PROFILE_CPUMHZ 7
+
+// IMC Field IDs for 'nodemetrics' messages. Every message type is a bytes field of [type:u8] followed by
+// the varints of its transmitted frames, transmitted bytes, received frames and received bytes.
+#define IMC_TRAFFIC_TYPE 1
+#define IMC_TRAFFIC_RXINVALID 2
+#define IMC_TRAFFIC_RXUNHANDLED 3
+#define IMC_TRAFFIC_RXFILTERED 4
+#define IMC_TRAFFIC_UPTIME 5
+#define IMC_TRAFFIC_TRUNCATED 6
+
+// IMC Field IDs for 'sensordata' messages. The ID indexes the SENSORKEYS table.
+#define IMC_SENSOR_HUM 1
+#define IMC_SENSOR_TEM 2
+#define IMC_SENSOR_GAS 3
+#define IMC_SENSOR_FLM 4
+#define IMC_SENSOR_AGE 5
+#define IMC_SENSOR_GASMIN 6
+#define IMC_SENSOR_GASMAX 7
+#define IMC_SENSOR_GASVAR 8
+
+// IMC Field IDs for 'configdata' messages. The ID indexes the CONFIGKEYS table.
+#define IMC_CONFIG_DHTTYP 1
+#define IMC_CONFIG_DHTPIN 2
+#define IMC_CONFIG_GASTYP 3
+#define IMC_CONFIG_GASPIN 4
+#define IMC_CONFIG_FLMTYP 5
+#define IMC_CONFIG_FLMPIN 6
+#define IMC_CONFIG_PINGER 7
+#define IMC_CONFIG_PINGERPIN 8
+#define IMC_CONFIG_SERIALBAUD 9
+#define IMC_CONFIG_CONNECTLEDPIN 10
+#define IMC_CONFIG_MESHGROUP 11
+
+// IMC Name Tables used to convert codes back into their meshlog strings
+const char *const MESSAGETYPES[] = {"unknown", "meshcommand", "handshake", "handshakeACK", "sensordata", "configdata", "connectionupdate", "historydata", "ack", "profiledata", "nodemetrics"};
+const char *const REACHTYPES[] = {"unknown", "unicast", "broadcast", "multicast"};
+const char *const COMMANDS[] = {"unknown", "readsensors", "readconfig", "readhistory", "readprofile", "readtraffic"};
+const char *const UPDATETYPES[] = {"unknown", "newconnection", "changedconnection"};
+const char *const SENSORKEYS[] = {"", "HUM", "TEM", "GAS", "FLM", "AGE", "GASMIN", "GASMAX", "GASVAR"};
+const char *const CONFIGKEYS[] = {"", "DHTTYP", "DHTPIN", "GASTYP", "GASPIN", "FLMTYP", "FLMPIN", "PINGER", "PINGERPIN", "SERIALBAUD", "CONNECTLEDPIN", "MESH_GROUP"};
+
+// A macro that returns the number of entries in a name table.
+#define TABLESIZE(table) (sizeof(table) / sizeof(table[0]))
+
+// A function that returns the name of a code from a name table, or the first entry if the code is out of range.
+const char *lookupname(const char *const table[], uint8_t tablesize, uint8_t code)
+{
+    return (code < tablesize) ? table[code] : table[0];
+}
+
+
+// A structure that holds a single decoded field of a mesh message.
+struct MeshField
+{
+    uint8_t kind;
+    uint8_t id;
+    uint32_t uintvalue;
+    float floatvalue;
+    const uint8_t *data;
+};
 
 
 /*
-A function that sends messages to the mesh based on the 'reach' parameters of the message document passed.
+A class that holds a single IMC mesh message in its binary wire format.
 
-Unicast - message is sent to node set in 'destination'
-Broadcast - message is sent to all nodes on the mesh.
+Every frame starts with a fixed header followed by the ping ID and a list of typed fields.
+header - [version:u8][type:u8][reach:u8][origin:u32][destination:u32]
+         The destination is the node ID for unicast, the group ID for multicast and 0 for broadcast.
+ping   - [length:u8][characters]
+fields - [tag:u8][value] where the tag is (kind << 5 | id) and the kind determines the value width.
+         Values of the bytes kind are written as [length:u8][bytes].
 
-Refer to API documentation for more information on the reach parameters of mesh messages.
+Field IDs are scoped to the message type. Fields with unknown IDs are skipped by the receiver,
+which allows new fields to be added without changing the wire version. All integers are little-endian.
+The frame is base64 encoded to be carried as the String payload of painlessMesh.
 */
-void sendmeshmessage(DynamicJsonDocument &messagedoc) 
+class MeshFrame
 {
-    // Serialize the Document into a String
-    String message; serializeJson(messagedoc, message);
-    // Detect the transmit method from the reach parameters of the document
-    String transmitmethod = messagedoc["reach"]["type"];
+  public:
+    uint8_t type;
+    uint8_t reach;
+    uint32_t origin;
+    uint32_t destination;
+    char ping[IMC_MAXPING + 1];
 
-    // Check the transmit method and perform the appropriate runtime
-    if (transmitmethod == "unicast") {
-        // Detect the destination from the reach parameters of the document
-        uint32_t destination = messagedoc["reach"]["destination"].as<uint32_t>();
-        // Unicast Transmit to the destination node
-        mesh.sendSingle(destination, message);
+    // Frame Construction Methods
+    bool begin(uint8_t messagetype, uint8_t reachtype, uint32_t originnode, uint32_t destinationnode, const char *pingid);
+    void addu8(uint8_t id, uint8_t value) {addfield(IMC_KIND_U8, id, value);}
+    void addbool(uint8_t id, bool value) {addfield(IMC_KIND_BOOL, id, value ? 1 : 0);}
+    void addu16(uint8_t id, uint16_t value) {addfield(IMC_KIND_U16, id, value);}
+    void addu32(uint8_t id, uint32_t value) {addfield(IMC_KIND_U32, id, value);}
+    void addf32(uint8_t id, float value);
+    void addbytes(uint8_t id, const uint8_t *data, uint8_t count);
+
+    // Frame Encoding and Decoding Methods
+    size_t encode(char *output, size_t outputsize);
+    bool decode(const char *input, size_t inputlength);
+
+    // Frame Field Access Methods
+    bool nextfield(uint16_t &cursor, MeshField &field);
+    bool findfield(uint8_t id, MeshField &field);
+    uint32_t getuint(uint8_t id, uint32_t fallback);
+
+    // Frame Raw Field Methods
+    uint16_t space() {return IMC_MAXFRAME - length;}
+    uint32_t hashfields();
+    uint16_t copyfields(uint8_t *output, uint16_t outputsize);
+    void addfields(const uint8_t *data, uint16_t count);
+
+  private:
+    uint8_t bytes[IMC_MAXFRAME];
+    uint16_t length;
+    uint16_t fieldstart;
+    bool overflow;
+
+    void addfield(uint8_t kind, uint8_t id, uint32_t value);
+    uint16_t valuesize(uint16_t cursor);
+    void putbytes(const uint8_t *data, uint8_t count);
+    void putuint(uint32_t value, uint8_t width);
+    uint32_t getbytes(uint16_t position, uint8_t width);
+};
+
+// A function that returns the width in bytes of a field value of the given kind or 0 for unknown kinds.
+uint8_t fieldwidth(uint8_t kind)
+{
+    switch (kind) {
+        case IMC_KIND_U8: return 1;
+        case IMC_KIND_BOOL: return 1;
+        case IMC_KIND_U16: return 2;
+        case IMC_KIND_U32: return 4;
+        case IMC_KIND_F32: return 4;
+        default: return 0;
     }
-    else if (transmitmethod == "broadcast") {
-        // Broadcast Transmit to all nodes
-        mesh.sendBroadcast(message);
+}
+
+// A function that computes the 32-bit FNV-1a hash of a byte buffer, continuing from a previous hash if one is passed.
+uint32_t hashbytes(const uint8_t *data, uint16_t count, uint32_t hash = 2166136261u)
+{
+    for (uint16_t i = 0; i < count; i++) {hash = (hash ^ data[i]) * 16777619u;}
+    return hash;
+}
+
+// A function that logs a ping ID that was rejected by a frame because it is too long.
+void logrejectedping(uint8_t messagetype, const char *pingid);
+
+/*
+A method that resets the frame and writes the message header and ping ID.
+Returns false if the ping ID is longer than IMC_MAXPING, in which case the rejection is
+logged and the frame is marked invalid so that it is never encoded or sent.
+*/
+bool MeshFrame::begin(uint8_t messagetype, uint8_t reachtype, uint32_t originnode, uint32_t destinationnode, const char *pingid)
+{
+    // Reset the frame state
+    length = 0;
+    overflow = false;
+    // Set the header values
+    type = messagetype;
+    reach = reachtype;
+    origin = originnode;
+    destination = (reachtype == IMC_BROADCAST) ? 0 : destinationnode;
+    // Reject a ping ID that does not fit the frame instead of truncating it
+    if (pingid == NULL) {pingid = "";}
+    size_t pinglength = strlen(pingid);
+    if (pinglength > IMC_MAXPING) {
+        ping[0] = '\0';
+        fieldstart = 0;
+        overflow = true;
+        logrejectedping(messagetype, pingid);
+        return false;
     }
+    // Copy the ping ID
+    memcpy(ping, pingid, pinglength);
+    ping[pinglength] = '\0';
+
+    // Write the header and ping ID into the frame
+    putuint(IMC_WIREVERSION, 1);
+    putuint(type, 1);
+    putuint(reach, 1);
+    putuint(origin, 4);
+    putuint(destination, 4);
+    putuint(pinglength, 1);
+    putbytes((const uint8_t *)ping, pinglength);
+    fieldstart = length;
+    return true;
 }
 
+// A method that appends a float field to the frame.
+void MeshFrame::addf32(uint8_t id, float value)
+{
+    uint32_t raw; memcpy(&raw, &value, sizeof(raw));
+    addfield(IMC_KIND_F32, id, raw);
+}
 
-// A function that reads the DHT sensor value and fills it into the passed document.
-void readsensor_DHT(DynamicJsonDocument &message) 
+// A method that appends a bytes field with its length to the frame.
+void MeshFrame::addbytes(uint8_t id, const uint8_t *data, uint8_t count)
 {
-    // Read Humidity and Temperature values from the sensor.
-    float hum = dht.readHumidity();
-    float tem = dht.readTemperature();
-    // Fill Humidity and Temperature values into the document.
-    message["data"]["sensors"]["HUM"] = hum;
-    message["data"]["sensors"]["TEM"] = tem;
+    putuint((IMC_KIND_BYTES << 5) | (id & 0x1F), 1);
+    putuint(count, 1);
+    putbytes(data, count);
+}
+
+/*
+A method that returns the size in bytes of the value of the field whose tag is at the cursor,
+or 0 if the kind is unknown or the value does not fit within the frame.
+*/
+uint16_t MeshFrame::valuesize(uint16_t cursor)
+{
+    uint8_t kind = bytes[cursor] >> 5;
+    uint16_t size = fieldwidth(kind);
+    if (kind == IMC_KIND_BYTES && cursor + 1 < length) {size = 1 + bytes[cursor + 1];}
+    if (size == 0 || cursor + 1 + size > length) {return 0;}
+    return size;
 }
 
+// A method that appends a field tag and its value to the frame.
+void MeshFrame::addfield(uint8_t kind, uint8_t id, uint32_t value)
+{
+    putuint((kind << 5) | (id & 0x1F), 1);
+    putuint(value, fieldwidth(kind));
+}
 
-// A function that reads the GAS sensor value and fills it into the passed document.
-void readsensor_GAS(DynamicJsonDocument &message) 
+// A method that appends raw bytes to the frame and flags an overflow if the frame is full.
+void MeshFrame::putbytes(const uint8_t *data, uint8_t count)
 {
-    // Read Analog value from the sensor.
-    int g = analogRead(GASPIN);
-    // Fill value into the document
-    message["data"]["sensors"]["GAS"] = g;
+    if (length + count > IMC_MAXFRAME) {overflow = true; return;}
+    memcpy(bytes + length, data, count);
+    length += count;
 }
 
+// A method that appends an unsigned integer of the given byte width to the frame in little-endian order.
+void MeshFrame::putuint(uint32_t value, uint8_t width)
+{
+    if (length + width > IMC_MAXFRAME) {overflow = true; return;}
+    for (uint8_t i = 0; i < width; i++) {bytes[length++] = (value >> (8 * i)) & 0xFF;}
+}
 
-// A function that reads the FLM sensor value and fills it into the passed document.
-void readsensor_FLM(DynamicJsonDocument &message) 
+// A method that reads an unsigned integer of the given byte width from the frame in little-endian order.
+uint32_t MeshFrame::getbytes(uint16_t position, uint8_t width)
 {
-    // Read Digital value from the sensor.
-    int f = digitalRead(FLMPIN);
-    // Fill value into the document
-    message["data"]["sensors"]["FLM"] = f;
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < width; i++) {value |= (uint32_t)bytes[position + i] << (8 * i);}
+    return value;
+}
+
+// The base64 alphabet used to encode frames into the painlessMesh String payload.
+const char BASE64CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// A function that returns the 6-bit value of a base64 character or -1 for invalid characters.
+int8_t base64value(char c)
+{
+    if (c >= 'A' && c <= 'Z') {return c - 'A';}
+    if (c >= 'a' && c <= 'z') {return c - 'a' + 26;}
+    if (c >= '0' && c <= '9') {return c - '0' + 52;}
+    if (c == '+') {return 62;}
+    if (c == '/') {return 63;}
+    return -1;
+}
+
+/*
+A method that encodes the frame into a null terminated base64 string.
+Returns the length of the encoded string or 0 if the frame overflowed or the output buffer is too small.
+*/
+size_t MeshFrame::encode(char *output, size_t outputsize)
+{
+    // Check that the frame is valid and that the output fits
+    size_t encodedlength = ((length + 2) / 3) * 4;
+    if (overflow || encodedlength + 1 > outputsize) {return 0;}
+
+    // Encode every group of 3 bytes into 4 characters
+    size_t o = 0;
+    for (uint16_t i = 0; i < length; i += 3) {
+        uint32_t group = (uint32_t)bytes[i] << 16;
+        if (i + 1 < length) {group |= (uint32_t)bytes[i + 1] << 8;}
+        if (i + 2 < length) {group |= bytes[i + 2];}
+
+        output[o++] = BASE64CHARS[(group >> 18) & 0x3F];
+        output[o++] = BASE64CHARS[(group >> 12) & 0x3F];
+        output[o++] = (i + 1 < length) ? BASE64CHARS[(group >> 6) & 0x3F] : '=';
+        output[o++] = (i + 2 < length) ? BASE64CHARS[group & 0x3F] : '=';
+    }
+
+    output[o] = '\0';
+    return o;
+}
+
+/*
+A method that decodes a base64 string into the frame and parses its header.
+Returns false if the string is not a valid frame of the current wire version.
+*/
+bool MeshFrame::decode(const char *input, size_t inputlength)
+{
+    // Reset the frame state
+    length = 0;
+    overflow = false;
+    type = IMC_UNKNOWN;
+
+    // Decode every group of 4 characters into 3 bytes
+    uint32_t group = 0; uint8_t bits = 0;
+    for (size_t i = 0; i < inputlength && input[i] != '='; i++) {
+        int8_t value = base64value(input[i]);
+        if (value < 0 || length >= IMC_MAXFRAME) {return false;}
+
+        group = (group << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            bytes[length++] = (group >> bits) & 0xFF;
+        }
+    }
+
+    // Validate the header and wire version
+    if (length < IMC_HEADERSIZE + 1 || bytes[0] != IMC_WIREVERSION) {return false;}
+    // Read the header values
+    type = bytes[1];
+    reach = bytes[2];
+    origin = getbytes(3, 4);
+    destination = getbytes(7, 4);
+
+    // Read the ping ID
+    uint8_t pinglength = bytes[IMC_HEADERSIZE];
+    if (pinglength > IMC_MAXPING || IMC_HEADERSIZE + 1 + pinglength > length) {return false;}
+    memcpy(ping, bytes + IMC_HEADERSIZE + 1, pinglength);
+    ping[pinglength] = '\0';
+    fieldstart = IMC_HEADERSIZE + 1 + pinglength;
+
+    // Validate that every field fits within the frame
+    uint16_t cursor = fieldstart;
+    while (cursor < length) {
+        uint16_t size = valuesize(cursor);
+        if (size == 0) {return false;}
+        cursor += 1 + size;
+    }
+
+    return true;
+}
+
+/*
+A function that decodes only the header of a base64 encoded frame to read its type, reach and destination.
+This lets a node discard messages that are not addressed to it or that it cannot handle before decoding the whole frame.
+Returns false if the string is too short to hold a header of the current wire version.
+*/
+bool peekframeheader(const char *input, size_t inputlength, uint8_t &type, uint8_t &reach, uint32_t &destination)
+{
+    // Decode the first 16 characters, which hold the 11 header bytes
+    uint8_t header[12];
+    if (inputlength < 16) {return false;}
+    for (uint8_t i = 0; i < 16; i += 4) {
+        uint32_t group = 0;
+        for (uint8_t j = 0; j < 4; j++) {
+            int8_t value = base64value(input[i + j]);
+            if (value < 0) {return false;}
+            group = (group << 6) | value;
+        }
+        header[i / 4 * 3] = (group >> 16) & 0xFF;
+        header[i / 4 * 3 + 1] = (group >> 8) & 0xFF;
+        header[i / 4 * 3 + 2] = group & 0xFF;
+    }
+
+    // Validate the wire version and read the type, reach and destination
+    if (header[0] != IMC_WIREVERSION) {return false;}
+    type = header[1];
+    reach = header[2];
+    destination = (uint32_t)header[7] | (uint32_t)header[8] << 8 | (uint32_t)header[9] << 16 | (uint32_t)header[10] << 24;
+    return true;
+}
+
+/*
+A method that reads the next field of the frame into the passed field structure.
+The cursor must be initialised to 0 and is advanced by each call. Returns false when there are no more fields.
+*/
+bool MeshFrame::nextfield(uint16_t &cursor, MeshField &field)
+{
+    // Start from the first field for a new cursor
+    if (cursor < fieldstart) {cursor = fieldstart;}
+    if (cursor >= length) {return false;}
+
+    // Read the field tag
+    uint8_t tag = bytes[cursor];
+    field.kind = tag >> 5;
+    field.id = tag & 0x1F;
+    uint16_t size = valuesize(cursor);
+    if (size == 0) {return false;}
+
+    // Read the field value. The value of a bytes field is its length and the data points into the frame.
+    field.uintvalue = 0;
+    field.floatvalue = 0;
+    field.data = NULL;
+    if (field.kind == IMC_KIND_BYTES) {field.uintvalue = size - 1; field.data = bytes + cursor + 2;}
+    else {field.uintvalue = getbytes(cursor + 1, size);}
+    if (field.kind == IMC_KIND_F32) {memcpy(&field.floatvalue, &field.uintvalue, sizeof(float));}
+
+    cursor += 1 + size;
+    return true;
+}
+
+// A method that finds the first field with the given ID. Returns false if it is not present.
+bool MeshFrame::findfield(uint8_t id, MeshField &field)
+{
+    uint16_t cursor = 0;
+    while (nextfield(cursor, field)) {
+        if (field.id == id) {return true;}
+    }
+    return false;
+}
+
+// A method that returns the integer value of the field with the given ID or the fallback if it is not present.
+uint32_t MeshFrame::getuint(uint8_t id, uint32_t fallback)
+{
+    MeshField field;
+    return findfield(id, field) ? field.uintvalue : fallback;
+}
+
+/*
+A method that returns the FNV-1a hash of the raw field bytes of the frame. The sequence field of the 
+reliable unicast layer is a transport field that differs with every message and is left out.
+*/
+uint32_t MeshFrame::hashfields()
+{
+    uint32_t hash = 2166136261u;
+    uint16_t cursor = fieldstart; MeshField field;
+    for (uint16_t start = cursor; nextfield(cursor, field); start = cursor) {
+        if (field.id != IMC_FIELD_SEQUENCE) {hash = hashbytes(bytes + start, cursor - start, hash);}
+    }
+    return hash;
+}
+
+/*
+A method that copies the raw field bytes of the frame into a buffer, leaving out the sequence field 
+of the reliable unicast layer. Returns 0 if they do not fit.
+*/
+uint16_t MeshFrame::copyfields(uint8_t *output, uint16_t outputsize)
+{
+    uint16_t count = 0;
+    uint16_t cursor = fieldstart; MeshField field;
+    for (uint16_t start = cursor; nextfield(cursor, field); start = cursor) {
+        if (field.id == IMC_FIELD_SEQUENCE) {continue;}
+        if (count + cursor - start > outputsize) {return 0;}
+        memcpy(output + count, bytes + start, cursor - start);
+        count += cursor - start;
+    }
+    return count;
+}
+
+// A method that appends raw field bytes copied from another frame to the frame.
+void MeshFrame::addfields(const uint8_t *data, uint16_t count)
+{
+    if (count > IMC_MAXFRAME) {overflow = true; return;}
+    putbytes(data, count);
+}
+
+
+// Pool Configuration Values
+#define FRAMEPOOLSIZE 4
+#define LOGPOOLSIZE 2
+// The document sizes are counted in value slots, which take 16 bytes on the ESP8266 and twice that on a
+// 64-bit host, so that the documents hold the same values on both.
+#define LOGDOCSIZE JSON_OBJECT_SIZE(64)
+// The command document holds a control command with a 'nodes' list of up to COMMANDDOC_MAXNODES node IDs,
+// its other members and some slack. The strings of the command stay in the line buffer it is parsed from.
+#define COMMANDDOC_MAXNODES 64
+#define COMMANDDOCSIZE (JSON_ARRAY_SIZE(COMMANDDOC_MAXNODES) + JSON_OBJECT_SIZE(8) + 128)
+
+// Preallocated Pools and Buffers. These are reused for every message so that the
+// message handling path does not allocate from the heap in steady state.
+MeshFrame FRAMEPOOL[FRAMEPOOLSIZE];
+bool FRAMEPOOLUSED[FRAMEPOOLSIZE];
+StaticJsonDocument<LOGDOCSIZE> LOGPOOL[LOGPOOLSIZE];
+bool LOGPOOLUSED[LOGPOOLSIZE];
+StaticJsonDocument<LOGDOCSIZE> LOGOVERFLOWDOC;
+StaticJsonDocument<COMMANDDOCSIZE> COMMANDDOC;
+char ENCODEBUFFER[IMC_MAXENCODED + 1];
+String TXPAYLOAD;
+
+// Pool and Heap Statistics
+uint8_t FRAMEPOOLPEAK = 0;
+uint32_t POOLEXHAUSTED = 0;
+uint32_t HEAPLOWWATER = UINT32_MAX;
+
+
+// A function that acquires a free frame from the frame pool. Returns NULL if the pool is exhausted.
+MeshFrame *acquireframe()
+{
+    uint8_t used = 0; MeshFrame *frame = NULL;
+    for (uint8_t i = 0; i < FRAMEPOOLSIZE; i++) {
+        if (!FRAMEPOOLUSED[i] && frame == NULL) {FRAMEPOOLUSED[i] = true; frame = &FRAMEPOOL[i];}
+        if (FRAMEPOOLUSED[i]) {used++;}
+    }
+
+    // Update the pool statistics
+    if (used > FRAMEPOOLPEAK) {FRAMEPOOLPEAK = used;}
+    if (frame == NULL) {POOLEXHAUSTED++;}
+    return frame;
+}
+
+// A function that returns a frame to the frame pool.
+void releaseframe(MeshFrame *frame)
+{
+    for (uint8_t i = 0; i < FRAMEPOOLSIZE; i++) {
+        if (frame == &FRAMEPOOL[i]) {FRAMEPOOLUSED[i] = false;}
+    }
+}
+
+// A class that holds a frame acquired from the frame pool for the duration of a scope.
+class PooledFrame
+{
+  public:
+    PooledFrame() {frame = acquireframe();}
+    ~PooledFrame() {releaseframe(frame);}
+    bool valid() {return frame != NULL;}
+    MeshFrame &operator*() {return *frame;}
+    MeshFrame *operator->() {return frame;}
+
+  private:
+    MeshFrame *frame;
+    PooledFrame(const PooledFrame &);
+    PooledFrame &operator=(const PooledFrame &);
+};
+
+
+// A function that returns the current free heap. The library reads the ESP core only through readfreeheap(), readcyclecount() and readcpumhz().
+uint32_t readfreeheap()
+{
+    return ESP.getFreeHeap();
+}
+
+// A function that returns the CPU cycle counter.
+uint32_t readcyclecount()
+{
+    return ESP.getCycleCount();
+}
+
+// A function that returns the CPU frequency in MHz.
+uint8_t readcpumhz()
+{
+    return ESP.getCpuFreqMHz();
+}
+
+// A function that records the lowest free heap observed since boot.
+void trackheap()
+{
+    uint32_t freeheap = readfreeheap();
+    if (freeheap < HEAPLOWWATER) {HEAPLOWWATER = freeheap;}
+}
+
+
+// A structure that holds the handling time statistics of a message type or control command.
+struct DispatchStats
+{
+    uint32_t count;
+    uint32_t totalmicros;
+    uint32_t maxmicros;
+};
+
+// Handling time statistics for every IMC message type, indexed by the message type.
+DispatchStats MESSAGESTATS[TABLESIZE(MESSAGETYPES)];
+
+// A function that records the time in microseconds spent handling a message or command.
+void recordelapsed(DispatchStats &stats, uint32_t elapsed)
+{
+    stats.count++;
+    stats.totalmicros += elapsed;
+    if (elapsed > stats.maxmicros) {stats.maxmicros = elapsed;}
+}
+
+// A function that records the time spent handling a message or command since the given start time.
+void recorddispatch(DispatchStats &stats, uint32_t started)
+{
+    recordelapsed(stats, micros() - started);
+}
+
+// A function that fills the statistics of a message type or control command into a meshlog as [count, totalmicros, maxmicros].
+void filldispatchstats(JsonObject target, const char *key, DispatchStats &stats)
+{
+    JsonArray values = target.createNestedArray(key);
+    values.add(stats.count);
+    values.add(stats.totalmicros);
+    values.add(stats.maxmicros);
+}
+
+
+// Log Sink Configuration Values
+#define LOGPRIORITY_NORMAL 0
+#define LOGPRIORITY_HIGH 1
+#define LOGSINK_NORMALSIZE 1024
+#define LOGSINK_HIGHSIZE 3072
+#define LOGSINK_STREAMSIZE 384
+
+// A structure that holds a ring buffer of meshlog records waiting to be written to the Serial port.
+struct LogRing
+{
+    uint8_t *buffer;
+    uint16_t size;
+    uint16_t start;
+    uint16_t length;
+    uint16_t pending;
+    bool overflow;
+    bool midrecord;
+    uint32_t dropped;
+};
+
+// A function that prints the next part of a streamed record and returns false once it has printed the last part.
+typedef bool (*logstreamsource)(Print &output);
+
+// A class that holds the part of a streamed record that is being written to the Serial port.
+class LogStreamBuffer : public Print
+{
+  public:
+    size_t write(uint8_t c)
+    {
+        // Parts are printed by their source into an empty buffer, which is sized for the largest part
+        if (length >= LOGSINK_STREAMSIZE) {return 0;}
+        buffer[length++] = c;
+        return 1;
+    }
+
+    uint8_t buffer[LOGSINK_STREAMSIZE];
+    uint16_t start;
+    uint16_t length;
+};
+
+/*
+A class that buffers meshlog records in two ring buffers and writes them to the Serial port without blocking.
+
+Records are written into the ring of their priority lane with begin(), print() and commit() and are drained
+by drain() from the update loop with only as many bytes as the Serial TX buffer can take. The high priority
+lane is always drained first. The normal lane drops (and counts) records that do not fit while the high
+priority lane is lossless and flushes itself to the Serial port when it is full, which is counted as a stall.
+A record that has been partially written to the Serial port is always completed before the other lane is drained.
+
+Records that are too large for the rings, like a sensor batch, are streamed instead. A streamed record is started
+with stream() and is printed part by part by its source as drain() writes it, after the high priority lane is
+empty and before the normal lane. Only one record is streamed at a time and a new stream completes the last one.
+*/
+class LogSink : public Print
+{
+  public:
+    LogSink(uint8_t *normalbuffer, uint16_t normalsize, uint8_t *highbuffer, uint16_t highsize);
+
+    void begin(uint8_t priority);
+    size_t write(uint8_t c);
+    void commit();
+    void drain(HardwareSerial &output);
+    Print &stream(logstreamsource source);
+    void completestream();
+
+    uint32_t dropped() {return normal.dropped + high.dropped;}
+    uint16_t available(uint8_t priority) {LogRing &ring = (priority == LOGPRIORITY_HIGH) ? high : normal; return ring.size - ring.length;}
+    uint32_t stalls;
+
+  private:
+    LogRing normal;
+    LogRing high;
+    LogRing *current;
+    LogStreamBuffer part;
+    logstreamsource streamsource;
+    bool streamstarted;
+    bool streamdone;
+
+    size_t drainring(LogRing &ring, Print &output, size_t budget, bool stopatrecord);
+    size_t drainstream(Print &output, size_t budget);
+};
+
+// LogSink Object Constructor
+LogSink::LogSink(uint8_t *normalbuffer, uint16_t normalsize, uint8_t *highbuffer, uint16_t highsize)
+{
+    memset(&normal, 0, sizeof(normal));
+    memset(&high, 0, sizeof(high));
+    normal.buffer = normalbuffer; normal.size = normalsize;
+    high.buffer = highbuffer; high.size = highsize;
+    current = &normal;
+    part.start = part.length = 0;
+    streamsource = NULL;
+    streamstarted = false;
+    streamdone = false;
+    stalls = 0;
+}
+
+// A method that starts a new record in the lane of the given priority.
+void LogSink::begin(uint8_t priority)
+{
+    current = (priority == LOGPRIORITY_HIGH) ? &high : &normal;
+    current->pending = 0;
+    current->overflow = false;
+}
+
+// A method that appends a byte to the current record.
+size_t LogSink::write(uint8_t c)
+{
+    LogRing &ring = *current;
+    if (ring.overflow) {return 1;}
+
+    // Check if the ring is full
+    if (ring.length + ring.pending >= ring.size) {
+        if (&ring == &normal) {
+            // Mark the record to be dropped
+            ring.overflow = true;
+            return 1;
+        }
+
+        // Complete any normal or streamed record partially written to the Serial port and
+        // flush the high priority ring including the current record to make space
+        drainring(normal, Serial, SIZE_MAX, true);
+        if (streamstarted) {drainstream(Serial, SIZE_MAX);}
+        ring.length += ring.pending;
+        ring.pending = 0;
+        drainring(ring, Serial, SIZE_MAX, false);
+        stalls++;
+    }
+
+    ring.buffer[(ring.start + ring.length + ring.pending) % ring.size] = c;
+    ring.pending++;
+    return 1;
+}
+
+// A method that completes the current record and makes it available to be drained or drops it if it did not fit.
+void LogSink::commit()
+{
+    LogRing &ring = *current;
+    if (ring.overflow) {ring.dropped++;}
+    else {ring.length += ring.pending;}
+
+    ring.pending = 0;
+    ring.overflow = false;
+}
+
+/*
+A method that writes up to 'budget' bytes of completed records from a ring to the output.
+If 'stopatrecord' is set, it only writes until the end of the record partially written to the output.
+Returns the number of bytes written.
+*/
+size_t LogSink::drainring(LogRing &ring, Print &output, size_t budget, bool stopatrecord)
+{
+    size_t written = 0;
+    while (ring.length > 0 && written < budget) {
+        if (stopatrecord && !ring.midrecord) {break;}
+
+        // Determine the contiguous chunk of the ring that can be written
+        size_t chunk = ring.size - ring.start;
+        if (chunk > ring.length) {chunk = ring.length;}
+        if (chunk > budget - written) {chunk = budget - written;}
+        if (stopatrecord) {
+            uint8_t *recordend = (uint8_t *)memchr(ring.buffer + ring.start, '\n', chunk);
+            if (recordend != NULL) {chunk = recordend - (ring.buffer + ring.start) + 1;}
+        }
+
+        // Write the chunk and advance the ring
+        output.write(ring.buffer + ring.start, chunk);
+        ring.midrecord = (ring.buffer[ring.start + chunk - 1] != '\n');
+        ring.start = (ring.start + chunk) % ring.size;
+        ring.length -= chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+/*
+A method that writes up to 'budget' bytes of the streamed record to the output, asking its source for the next
+part whenever the last part has been written. Returns the number of bytes written.
+*/
+size_t LogSink::drainstream(Print &output, size_t budget)
+{
+    size_t written = 0;
+    while (streamsource != NULL && written < budget) {
+        // Get the next part from the source once the last part has been written
+        if (part.start == part.length) {
+            if (streamdone) {streamsource = NULL; streamstarted = false; break;}
+            part.start = part.length = 0;
+            streamdone = !streamsource(part);
+            continue;
+        }
+
+        // Write as much of the part as the budget allows
+        size_t chunk = part.length - part.start;
+        if (chunk > budget - written) {chunk = budget - written;}
+        output.write(part.buffer + part.start, chunk);
+        part.start += chunk;
+        streamstarted = true;
+        written += chunk;
+    }
+    return written;
+}
+
+// A method that writes as many buffered bytes as the Serial TX buffer can take without blocking.
+void LogSink::drain(HardwareSerial &output)
+{
+    size_t budget = output.availableForWrite();
+
+    // Complete a streamed record that is partially written before anything else
+    if (streamstarted) {
+        budget -= drainstream(output, budget);
+        if (streamstarted) {return;}
+    }
+
+    // Drain the high priority lane first unless a normal record is partially written
+    LogRing *order[2] = {&high, &normal};
+    if (normal.midrecord) {order[0] = &normal; order[1] = &high;}
+
+    for (uint8_t i = 0; i < 2 && budget > 0; i++) {
+        budget -= drainring(*order[i], output, budget, false);
+        // Stop if the budget ran out in the middle of a record
+        if (order[i]->midrecord) {break;}
+        // Start the streamed record once the high priority lane is empty
+        if (order[i] == &high && high.length == 0 && streamsource != NULL) {
+            budget -= drainstream(output, budget);
+            if (streamstarted) {break;}
+        }
+    }
 }
 
+/*
+A method that starts a streamed record with the given source and returns the Print that its first part is printed into.
+A record that is still being streamed is completed first, as its source may depend on state the new record replaces.
+*/
+Print &LogSink::stream(logstreamsource source)
+{
+    completestream();
+    streamsource = source;
+    streamdone = false;
+    part.start = part.length = 0;
+    return part;
+}
+
+// A method that writes the rest of the streamed record to the Serial port, blocking if needed. This is counted as a stall.
+void LogSink::completestream()
+{
+    if (streamsource == NULL) {return;}
+    // Write the buffered records that rank ahead of the stream unless it is partially written
+    if (!streamstarted) {
+        drainring(normal, Serial, SIZE_MAX, true);
+        drainring(high, Serial, SIZE_MAX, false);
+    }
+    drainstream(Serial, SIZE_MAX);
+    stalls++;
+}
+
+// Global Log Sink and its Buffers
+uint8_t LOGSINKNORMALBUFFER[LOGSINK_NORMALSIZE];
+uint8_t LOGSINKHIGHBUFFER[LOGSINK_HIGHSIZE];
+LogSink LOGSINK(LOGSINKNORMALBUFFER, LOGSINK_NORMALSIZE, LOGSINKHIGHBUFFER, LOGSINK_HIGHSIZE);
+uint8_t LOGPOOLPRIORITY[LOGPOOLSIZE];
+
 
 /*
-A command handler that responds to the command 'readsensors'. 
-The runtime fills in the sensor readings based on the hardware configuration values, 
-wraps it into a 'sensordata' message and sends it to the MESHCONTROLNODE.
+A function that acquires a meshlog document from the log pool and fills in the common meshlog values.
+If the pool is exhausted, a scratch document is returned which is discarded by endmeshlog().
+Every document must be passed to endmeshlog() once it has been filled in.
+The priority determines the lane of the log sink that the meshlog is written into.
 */
-void handlecommand_readsensors(String pingid) 
+JsonDocument &beginmeshlog(const char *logtype, const char *logmessage, uint8_t priority = LOGPRIORITY_NORMAL)
 {
-    // Create the sensordata document
-    DynamicJsonDocument sensordata(1024);
-    sensordata["type"] = "message";
-    sensordata["origin"] = mesh.getNodeId();
-    // Set the reach parameters to unicast with the Control Node as the destination
-    sensordata["reach"]["type"] = "unicast";
-    sensordata["reach"]["destination"] = MESHCONTROLNODE;
-    // Fill in the ping ID and set the message type.
-    sensordata["data"]["ping"] = pingid;
-    sensordata["data"]["type"] = "sensordata";
+    // Acquire a free document from the pool
+    JsonDocument *logdoc = &LOGOVERFLOWDOC;
+    for (uint8_t i = 0; i < LOGPOOLSIZE; i++) {
+        if (!LOGPOOLUSED[i]) {
+            LOGPOOLUSED[i] = true;
+            LOGPOOLPRIORITY[i] = priority;
+            logdoc = &LOGPOOL[i];
+            break;
+        }
+    }
+    if (logdoc == &LOGOVERFLOWDOC) {POOLEXHAUSTED++;}
 
-    // Fill in sensordata readings for DHT
-    if (DHTTYP > 0) {readsensor_DHT(sensordata);}
-    // Fill in sensordata readings for GAS
-    if (GASTYP > 0) {readsensor_GAS(sensordata);}
-    // Fill in sensordata readings for FLM
-    if (FLMTYP > 0) {readsensor_FLM(sensordata);}
+    // Fill in the common meshlog values
+    logdoc->clear();
+    (*logdoc)["type"] = "meshlog";
+    (*logdoc)["nodeID"] = mesh.getNodeId();
+    (*logdoc)["nodetime"] = mesh.getNodeTime();
+    (*logdoc)["logdata"]["type"] = logtype;
+    (*logdoc)["logdata"]["message"] = logmessage;
+    return *logdoc;
+}
+
+/*
+A function that returns a meshlog document to the log pool and reads the priority it was acquired with.
+Returns false if the document was the scratch document, in which case it must not be logged.
+*/
+bool releasemeshlog(JsonDocument &logdoc, uint8_t &priority)
+{
+    for (uint8_t i = 0; i < LOGPOOLSIZE; i++) {
+        if (&logdoc == &LOGPOOL[i]) {
+            LOGPOOLUSED[i] = false;
+            priority = LOGPOOLPRIORITY[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// A function that logs a meshlog document to the log sink and returns it to the log pool.
+void endmeshlog(JsonDocument &logdoc)
+{
+    // Discard the scratch document used when the pool was exhausted
+    uint8_t priority;
+    if (!releasemeshlog(logdoc, priority)) {return;}
+    LOGSINK.begin(priority);
+
+    // Log the document to the log sink. The document is not reused until this function returns.
+    serializeJson(logdoc, LOGSINK); LOGSINK.println();
+    LOGSINK.commit();
+}
+
+// A function that logs a ping ID that was rejected by a frame because it is too long.
+void logrejectedping(uint8_t messagetype, const char *pingid)
+{
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("pingrejected", "ping ID is too long for a mesh message", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values. The ping is copied as it may not outlive the document.
+    logdoc["logdata"]["txtype"] = lookupname(MESSAGETYPES, TABLESIZE(MESSAGETYPES), messagetype);
+    logdoc["logdata"]["ping"] = (char *)pingid;
+    logdoc["logdata"]["maxlength"] = IMC_MAXPING;
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
+
+
+/*
+A class that forwards everything printed to it to another Print object except for the last 'trim' bytes.
+Used to stream a meshlog document with its closing braces held back so that more values can be appended.
+*/
+class TrimmedPrint : public Print
+{
+  public:
+    TrimmedPrint(Print &target, uint8_t trim) : output(target), trimcount(trim), held(0) {}
+
+    size_t write(uint8_t c)
+    {
+        // Forward the oldest held byte once 'trim' bytes are already held
+        if (held == trimcount) {
+            output.write(holdbuffer[0]);
+            memmove(holdbuffer, holdbuffer + 1, held - 1);
+            held--;
+        }
+        holdbuffer[held++] = c;
+        return 1;
+    }
+
+  private:
+    Print &output;
+    uint8_t trimcount;
+    uint8_t held;
+    uint8_t holdbuffer[4];
+};
+
+
+/*
+A function that logs a meshlog document to the log sink without its closing braces and returns it to the log pool.
+Further values of the 'logdata' object can then be streamed to LOGSINK with a leading comma and the meshlog
+must be completed with closemeshlog(). Used for meshlogs that are too large for a log document.
+Returns false if the document was the scratch document, in which case nothing is logged.
+*/
+bool openmeshlog(JsonDocument &logdoc)
+{
+    // Discard the scratch document used when the pool was exhausted
+    uint8_t priority;
+    if (!releasemeshlog(logdoc, priority)) {return false;}
+    LOGSINK.begin(priority);
+
+    // Log the document to the log sink without the closing braces of 'logdata' and the document
+    TrimmedPrint output(LOGSINK, 2);
+    serializeJson(logdoc, output);
+    return true;
+}
+
+/*
+A function that starts a streamed record in the log sink with a meshlog document without its closing braces
+and returns the document to the log pool. The source prints the further values of 'logdata' with a leading
+comma as the log sink drains the record, and its last part must close the meshlog with "}}" and a line end.
+Used for meshlogs that are too large for the log sink. Returns false if the document was the scratch document.
+*/
+bool streammeshlog(JsonDocument &logdoc, logstreamsource source)
+{
+    // Discard the scratch document used when the pool was exhausted
+    uint8_t priority;
+    if (!releasemeshlog(logdoc, priority)) {return false;}
+
+    // Print the document as the first part of the streamed record
+    TrimmedPrint output(LOGSINK.stream(source), 2);
+    serializeJson(logdoc, output);
+    return true;
+}
+
+// A function that completes a meshlog that was started with openmeshlog().
+void closemeshlog()
+{
+    LOGSINK.print("}}"); LOGSINK.println();
+    LOGSINK.commit();
+}
+
+
+// A function that fills a raw field value into a JSON object with a JSON type matching the field kind.
+void fillfieldvalue(JsonObject target, const char *key, uint8_t kind, uint32_t raw)
+{
+    if (kind == IMC_KIND_F32) {float value; memcpy(&value, &raw, sizeof(value)); target[key] = value;}
+    else if (kind == IMC_KIND_BOOL) {target[key] = (raw != 0);}
+    else {target[key] = raw;}
+}
+
+
+/*
+A function that fills the fields of a mesh message into a JSON object.
+The field IDs are converted into keys using the passed key table and fields with unknown IDs are skipped.
+*/
+void fillmeshfields(MeshFrame &message, JsonObject target, const char *const keys[], uint8_t keycount)
+{
+    uint16_t cursor = 0; MeshField field;
+    while (message.nextfield(cursor, field)) {
+        // Skip fields that are not present in the key table
+        if (field.id == 0 || field.id >= keycount) {continue;}
+
+        // Fill the value with a JSON type matching the field kind
+        fillfieldvalue(target, keys[field.id], field.kind, field.uintvalue);
+    }
+}
+
+
+// A structure that holds the traffic counters of a message type sent or received with a reach type. The byte counts are of the encoded payloads.
+struct TrafficCounters
+{
+    uint32_t txframes;
+    uint32_t txbytes;
+    uint32_t rxframes;
+    uint32_t rxbytes;
+};
+
+// Traffic counters for every IMC message type and reach type, indexed by the message type and then the reach type.
+TrafficCounters TRAFFIC[TABLESIZE(MESSAGETYPES)][TABLESIZE(REACHTYPES)];
+// Counters of received messages that could not be decoded, had no handler or were for another multicast group.
+uint32_t RXINVALID = 0;
+uint32_t RXUNHANDLED = 0;
+uint32_t RXFILTERED = 0;
+
+// A function that returns the traffic counters of a message type and reach type. Unknown types and reaches are counted as unknown.
+TrafficCounters &trafficcounters(uint8_t type, uint8_t reach)
+{
+    if (type >= TABLESIZE(MESSAGETYPES)) {type = IMC_UNKNOWN;}
+    if (reach >= TABLESIZE(REACHTYPES)) {reach = 0;}
+    return TRAFFIC[type][reach];
+}
+
+// A function that counts a transmitted message with its type, reach and encoded length.
+void counttransmit(uint8_t type, uint8_t reach, uint16_t length)
+{
+    TrafficCounters &counters = trafficcounters(type, reach);
+    counters.txframes++;
+    counters.txbytes += length;
+}
+
+// A function that counts a received message with its type, reach and encoded length.
+void countreceive(uint8_t type, uint8_t reach, uint16_t length)
+{
+    TrafficCounters &counters = trafficcounters(type, reach);
+    counters.rxframes++;
+    counters.rxbytes += length;
+}
+
+
+// Reliable Unicast Configuration Values
+#ifndef RELIABLE_UNICAST
+#define RELIABLE_UNICAST true
+#endif
+#define RELIABLE_WINDOW 8
+#define RELIABLE_TIMEOUT 1000
+#define RELIABLE_RETRIES 3
+#define RELIABLE_INTERVAL 100
+#define RELIABLE_DEDUP 64
+
+// A structure that holds an encoded reliable unicast message waiting for its ack.
+struct ReliableSlot
+{
+    bool active;
+    uint8_t type;
+    uint8_t retries;
+    uint16_t sequence;
+    uint32_t destination;
+    uint32_t sent;
+    char payload[IMC_MAXENCODED + 1];
+};
+
+// A structure that holds the origin and sequence number of a received reliable unicast message.
+struct ReliableSeen
+{
+    uint32_t node;
+    uint16_t sequence;
+};
+
+// The retransmit window, the duplicate suppression window and the sequence number of the node
+ReliableSlot RELIABLESLOTS[RELIABLE_WINDOW];
+ReliableSeen RELIABLESEEN[RELIABLE_DEDUP];
+uint8_t RELIABLESEENHEAD = 0;
+uint16_t RELIABLESEQUENCE = 0;
+
+// Reliable Unicast Statistics
+uint32_t RELIABLERETRIES = 0;
+uint32_t RELIABLEGIVEUPS = 0;
+uint32_t RELIABLEDUPLICATES = 0;
+uint32_t RELIABLEUNTRACKED = 0;
+
+/*
+A function that checks if a message is sent with the reliable unicast layer. Acks are never acknowledged,
+and messages without a destination (such as a reply before the control node is known) are not tracked.
+*/
+bool isreliable(MeshFrame &message)
+{
+    return RELIABLE_UNICAST && message.reach == IMC_UNICAST && message.type != IMC_ACK && message.destination != 0;
+}
+
+/*
+A function that stores the encoded payload of a reliable message in the retransmit window until it is acked.
+If the window is full, the message is sent without retransmission and counted as untracked.
+*/
+void storereliable(MeshFrame &message, uint16_t sequence, const char *payload)
+{
+    for (uint8_t i = 0; i < RELIABLE_WINDOW; i++) {
+        ReliableSlot &slot = RELIABLESLOTS[i];
+        if (slot.active) {continue;}
+        slot.active = true;
+        slot.type = message.type;
+        slot.retries = 0;
+        slot.sequence = sequence;
+        slot.destination = message.destination;
+        slot.sent = millis();
+        strcpy(slot.payload, payload);
+        return;
+    }
+    RELIABLEUNTRACKED++;
+}
+
+// A function that checks if the retransmit window has a free slot for the next reliable message.
+bool reliablewindowfree()
+{
+    for (uint8_t i = 0; i < RELIABLE_WINDOW; i++) {
+        if (!RELIABLESLOTS[i].active) {return true;}
+    }
+    return false;
+}
+
+/*
+A function that runs the retransmit runtime of the reliable unicast layer. Called by the reliabletask on
+the meshScheduler every RELIABLE_INTERVAL milliseconds. A message that has not been acked is retransmitted
+after RELIABLE_TIMEOUT milliseconds, with the timeout growing with every retry, and is given up and logged
+after RELIABLE_RETRIES retransmissions.
+*/
+void retransmitreliable()
+{
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < RELIABLE_WINDOW; i++) {
+        ReliableSlot &slot = RELIABLESLOTS[i];
+        if (!slot.active || now - slot.sent < (uint32_t)RELIABLE_TIMEOUT * (slot.retries + 1)) {continue;}
+
+        // Give up on the message once the retries have run out
+        if (slot.retries >= RELIABLE_RETRIES) {
+            slot.active = false;
+            RELIABLEGIVEUPS++;
+
+            // Create the meshlog document
+            JsonDocument &logdoc = beginmeshlog("reliablegiveup", "reliable message was not acknowledged");
+            // Fill in the meshlog values
+            logdoc["logdata"]["txtype"] = lookupname(MESSAGETYPES, TABLESIZE(MESSAGETYPES), slot.type);
+            logdoc["logdata"]["destination"] = slot.destination;
+            // Log the document to the Serial port.
+            endmeshlog(logdoc);
+            continue;
+        }
+
+        // Retransmit the stored payload
+        TXPAYLOAD = slot.payload;
+        mesh.sendSingle(slot.destination, TXPAYLOAD);
+        counttransmit(slot.type, IMC_UNICAST, TXPAYLOAD.length());
+        slot.retries++;
+        slot.sent = now;
+        RELIABLERETRIES++;
+    }
+}
+
+// A function that sends an ack for a reliable message with the given sequence number back to its origin.
+void sendack(uint32_t node, uint16_t sequence);
+
+/*
+A function that runs the receive side of the reliable unicast layer for a decoded message.
+Acks release their message from the retransmit window, reliable messages are acked, and messages
+that have already been received are dropped. Returns true if the message has been consumed.
+*/
+bool consumereliable(MeshFrame &message)
+{
+    MeshField field;
+    if (!message.findfield(IMC_FIELD_SEQUENCE, field)) {return false;}
+    uint16_t sequence = field.uintvalue;
+
+    // Release the acked message from the retransmit window
+    if (message.type == IMC_ACK) {
+        for (uint8_t i = 0; i < RELIABLE_WINDOW; i++) {
+            ReliableSlot &slot = RELIABLESLOTS[i];
+            if (slot.active && slot.destination == message.origin && slot.sequence == sequence) {slot.active = false;}
+        }
+        return true;
+    }
+
+    // Ack the message, even if it is a duplicate whose earlier ack was lost
+    sendack(message.origin, sequence);
+
+    // Drop the message if it is in the duplicate suppression window, otherwise remember it
+    for (uint8_t i = 0; i < RELIABLE_DEDUP; i++) {
+        if (RELIABLESEEN[i].node == message.origin && RELIABLESEEN[i].sequence == sequence) {
+            RELIABLEDUPLICATES++;
+            return true;
+        }
+    }
+    RELIABLESEEN[RELIABLESEENHEAD].node = message.origin;
+    RELIABLESEEN[RELIABLESEENHEAD].sequence = sequence;
+    RELIABLESEENHEAD = (RELIABLESEENHEAD + 1) % RELIABLE_DEDUP;
+    return false;
+}
+
+// A function that starts the reliable unicast layer with a random first sequence number.
+void startreliable()
+{
+    RELIABLESEQUENCE = random(65536);
+    meshScheduler.addTask(reliabletask);
+    reliabletask.setInterval(RELIABLE_INTERVAL);
+    reliabletask.enable();
+}
+
+
+/*
+A function that sends messages to the mesh based on the 'reach' parameters of the message frame passed.
+
+Unicast - message is sent to node set in 'destination'
+Broadcast - message is sent to all nodes on the mesh.
+Multicast - message is sent to all nodes on the mesh and only handled by the nodes of the group set in 'destination'.
+
+Refer to API documentation for more information on the reach parameters of mesh messages.
+*/
+void sendmeshmessage(MeshFrame &message)
+{
+    // Number reliable unicast messages with the next sequence number
+    bool reliable = isreliable(message);
+    uint16_t sequence = reliable ? RELIABLESEQUENCE++ : 0;
+    if (reliable) {message.addu16(IMC_FIELD_SEQUENCE, sequence);}
+
+    // Encode the frame into its base64 wire representation. The payload
+    // String is reserved at startup and reused to avoid reallocation.
+    size_t encodedlength = message.encode(ENCODEBUFFER, sizeof(ENCODEBUFFER));
+    if (encodedlength == 0) {return;}
+    TXPAYLOAD = ENCODEBUFFER;
+    counttransmit(message.type, message.reach, encodedlength);
+    // Keep reliable messages for retransmission until they are acked
+    if (reliable) {storereliable(message, sequence, ENCODEBUFFER);}
+
+    // Check the transmit method and perform the appropriate runtime
+    if (message.reach == IMC_UNICAST) {
+        // Unicast Transmit to the destination node
+        mesh.sendSingle(message.destination, TXPAYLOAD);
+    }
+    else if (message.reach == IMC_BROADCAST || message.reach == IMC_MULTICAST) {
+        // Broadcast Transmit to all nodes. Multicast messages are filtered by the receivers.
+        mesh.sendBroadcast(TXPAYLOAD);
+    }
+}
+
+
+// A function that sends an ack for a reliable message with the given sequence number back to its origin.
+void sendack(uint32_t node, uint16_t sequence)
+{
+    PooledFrame ack;
+    if (!ack.valid()) {return;}
+    ack->begin(IMC_ACK, IMC_UNICAST, mesh.getNodeId(), node, NULL);
+    ack->addu16(IMC_FIELD_SEQUENCE, sequence);
+    sendmeshmessage(*ack);
+}
+
+
+// A structure that holds a single reading of all the sensors of the node.
+struct SensorSample
+{
+    float hum;
+    float tem;
+    uint16_t gas;
+    uint16_t gasmin;
+    uint16_t gasmax;
+    float gasvar;
+    uint8_t flm;
+};
+
+
+/*
+The sensor drivers. Every sensor interface of the node is handled by a driver with an init runtime that 
+sets up the sensor, a sample runtime that reads it into a sample, a report runtime that fills the sample 
+values into a 'sensordata' message and a config runtime that fills its configuration values into a 
+'configdata' message. The drivers are registered in the SENSORDRIVERS table.
+*/
+#if SENSORDRIVER_DHT
+// A function that initialises the DHT sensor.
+void initsensor_DHT()
+{
+    dht.begin();
+}
+
+// A function that reads the DHT sensor values into the passed sample.
+void readsensor_DHT(SensorSample &sample)
+{
+    // Read Humidity and Temperature values from the sensor.
+    sample.hum = dht.readHumidity();
+    sample.tem = dht.readTemperature();
+}
+
+// A function that fills the DHT sensor values of a sample into the passed message.
+void reportsensor_DHT(MeshFrame &message, SensorSample &sample)
+{
+    message.addf32(IMC_SENSOR_HUM, sample.hum);
+    message.addf32(IMC_SENSOR_TEM, sample.tem);
+}
+
+// A function that fills the DHT configuration values into the passed message.
+void configsensor_DHT(MeshFrame &message)
+{
+    message.addu8(IMC_CONFIG_DHTTYP, DHTTYP);
+    message.addu8(IMC_CONFIG_DHTPIN, DHTPIN);
+}
+#endif
+
+
+#if SENSORDRIVER_GAS
+// Gas Filter Configuration Values
+#define GASFILTER_MEAN 0
+#define GASFILTER_MEDIAN 1
+#define GASFILTER_EMA 2
+#ifndef GAS_FILTER
+#define GAS_FILTER GASFILTER_MEDIAN
+#endif
+#ifndef GAS_WINDOW
+#define GAS_WINDOW 32
+#endif
+#ifndef GAS_EMAWEIGHT
+#define GAS_EMAWEIGHT 0.25f
+#endif
+
+// The window of raw oversampled GAS values and the exponentially smoothed GAS value.
+uint16_t GASWINDOW[GAS_WINDOW];
+uint8_t GASWINDOWHEAD = 0;
+uint8_t GASWINDOWCOUNT = 0;
+float GASSMOOTHED = 0;
+
+/*
+The GAS filter kernels. They work on a plain array of values in any order. The mean and 
+statistics kernels keep their loops free of branches so that the compiler can vectorize them.
+*/
+// A filter kernel that returns the rounded mean of the values.
+uint16_t gasfilter_mean(const uint16_t *values, uint8_t count)
+{
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < count; i++) {sum += values[i];}
+    return (sum + count / 2) / count;
+}
+
+// A filter kernel that returns the median of the values.
+uint16_t gasfilter_median(const uint16_t *values, uint8_t count)
+{
+    // Insertion sort a copy of the values
+    uint16_t sorted[GAS_WINDOW];
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t value = values[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {sorted[j] = sorted[j - 1]; j--;}
+        sorted[j] = value;
+    }
+    return sorted[count / 2];
+}
+
+/*
+A filter kernel that computes the minimum, maximum and population variance of the values.
+The variance is computed as (count * squares - sum * sum) / count^2 in integers, which is exact 
+unlike the difference of the float mean of the squares and the squared mean, and is clamped at 0.
+*/
+void gasfilter_statistics(const uint16_t *values, uint8_t count, uint16_t &minimum, uint16_t &maximum, float &variance)
+{
+    uint16_t low = UINT16_MAX; uint16_t high = 0;
+    uint32_t sum = 0; uint64_t squares = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t value = values[i];
+        low = (value < low) ? value : low;
+        high = (value > high) ? value : high;
+        sum += value;
+        squares += (uint32_t)value * value;
+    }
+    uint64_t scaledsquares = (uint64_t)count * squares;
+    uint64_t squaredsum = (uint64_t)sum * sum;
+    minimum = low;
+    maximum = high;
+    variance = (scaledsquares > squaredsum) ? (float)(scaledsquares - squaredsum) / ((float)count * count) : 0;
+}
+
+/*
+A function that oversamples the GAS sensor into the passed sample. Each call adds one raw analog 
+value to the GASWINDOW and fills the sample with the GAS_FILTER value of the window along with 
+the raw minimum, maximum and variance of the window.
+*/
+void readsensor_GAS(SensorSample &sample)
+{
+    // Read Analog value from the sensor into the window
+    uint16_t raw = analogRead(GASPIN);
+    GASWINDOW[GASWINDOWHEAD] = raw;
+    GASWINDOWHEAD = (GASWINDOWHEAD + 1) % GAS_WINDOW;
+    if (GASWINDOWCOUNT < GAS_WINDOW) {GASWINDOWCOUNT++;}
+    // Update the exponentially smoothed value
+    GASSMOOTHED = (GASWINDOWCOUNT == 1) ? raw : GASSMOOTHED + GAS_EMAWEIGHT * (raw - GASSMOOTHED);
+
+    // Fill the filtered value and the window statistics into the sample
+#if GAS_FILTER == GASFILTER_MEAN
+    sample.gas = gasfilter_mean(GASWINDOW, GASWINDOWCOUNT);
+#elif GAS_FILTER == GASFILTER_EMA
+    sample.gas = lroundf(GASSMOOTHED);
+#else
+    sample.gas = gasfilter_median(GASWINDOW, GASWINDOWCOUNT);
+#endif
+    gasfilter_statistics(GASWINDOW, GASWINDOWCOUNT, sample.gasmin, sample.gasmax, sample.gasvar);
+}
+
+// A function that initialises the GAS sensor pin.
+void initsensor_GAS()
+{
+    pinMode(GASPIN, INPUT);
+}
+
+// A function that fills the GAS sensor value of a sample with the statistics of its window into the passed message.
+void reportsensor_GAS(MeshFrame &message, SensorSample &sample)
+{
+    message.addu16(IMC_SENSOR_GAS, sample.gas);
+    message.addu16(IMC_SENSOR_GASMIN, sample.gasmin);
+    message.addu16(IMC_SENSOR_GASMAX, sample.gasmax);
+    message.addf32(IMC_SENSOR_GASVAR, sample.gasvar);
+}
+
+// A function that fills the GAS configuration values into the passed message.
+void configsensor_GAS(MeshFrame &message)
+{
+    message.addu8(IMC_CONFIG_GASTYP, GASTYP);
+    message.addu8(IMC_CONFIG_GASPIN, GASPIN);
+}
+#endif
+
+
+#if SENSORDRIVER_FLM
+// A function that initialises the FLM sensor pin.
+void initsensor_FLM()
+{
+    pinMode(FLMPIN, INPUT);
+}
+
+// A function that reads the FLM sensor value into the passed sample.
+void readsensor_FLM(SensorSample &sample)
+{
+    // Read Digital value from the sensor.
+    sample.flm = digitalRead(FLMPIN);
+}
+
+// A function that fills the FLM sensor value of a sample into the passed message.
+void reportsensor_FLM(MeshFrame &message, SensorSample &sample)
+{
+    message.addu8(IMC_SENSOR_FLM, sample.flm);
+}
+
+// A function that fills the FLM configuration values into the passed message.
+void configsensor_FLM(MeshFrame &message)
+{
+    message.addu8(IMC_CONFIG_FLMTYP, FLMTYP);
+    message.addu8(IMC_CONFIG_FLMPIN, FLMPIN);
+}
+#endif
+
+
+// Sensor Sampling Configuration Values
+#define SAMPLE_INTERVAL 50
+#define SAMPLE_DHTINTERVAL 2000
+#define SAMPLE_BUDGET 5000
+
+// A structure that registers a sensor driver with the configured type of its sensor and its sampling cadence in milliseconds, where 0 samples it on every run.
+struct SensorDriver
+{
+    const char *name;
+    const int *type;
+    uint32_t interval;
+    void (*init)();
+    void (*sample)(SensorSample &sample);
+    void (*report)(MeshFrame &message, SensorSample &sample);
+    void (*config)(MeshFrame &message);
+};
+
+/*
+The sensor driver table. New sensor drivers are registered by adding an entry here, and a driver whose 
+flag is false is compiled out along with its runtimes and state. A driver is only used when the type 
+of its sensor is configured. Drivers are sampled, reported and configured in the order of the table.
+The table ends with a null entry that is always present, so that a build without any driver (such as a 
+control node build with the CONFIG_ flags) still has a valid table. It is not counted in SENSORDRIVERCOUNT.
+*/
+const SensorDriver SENSORDRIVERS[] = {
+#if SENSORDRIVER_DHT
+    {"DHT", &DHTTYP, SAMPLE_DHTINTERVAL, initsensor_DHT, readsensor_DHT, reportsensor_DHT, configsensor_DHT},
+#endif
+#if SENSORDRIVER_GAS
+    {"GAS", &GASTYP, 0, initsensor_GAS, readsensor_GAS, reportsensor_GAS, configsensor_GAS},
+#endif
+#if SENSORDRIVER_FLM
+    {"FLM", &FLMTYP, 0, initsensor_FLM, readsensor_FLM, reportsensor_FLM, configsensor_FLM},
+#endif
+    {NULL, NULL, 0, NULL, NULL, NULL, NULL}
+};
+
+// The number of sensor drivers compiled in, without the null entry of the table.
+#define SENSORDRIVERCOUNT (TABLESIZE(SENSORDRIVERS) - 1)
+
+// A macro that returns true if the sensor of a driver in the driver table is attached to the node.
+#define DRIVERATTACHED(index) (*SENSORDRIVERS[index].type > 0)
+
+// The latest sample of every sensor attached to the node, the time (millis) each driver was sampled and the sampling time statistics of each driver.
+SensorSample SENSORCACHE;
+uint32_t DRIVERSAMPLETIME[TABLESIZE(SENSORDRIVERS)];
+DispatchStats DRIVERSTATS[TABLESIZE(SENSORDRIVERS)];
+bool SENSORSAMPLED = false;
+
+// A function that initialises the sensors of every attached driver.
+void initsensordrivers()
+{
+    for (uint8_t index = 0; index < SENSORDRIVERCOUNT; index++) {
+        if (DRIVERATTACHED(index)) {SENSORDRIVERS[index].init();}
+    }
+}
+
+/*
+A function that runs the sensor sampling runtime. Called by the sampletask on the meshScheduler every 
+SAMPLE_INTERVAL milliseconds to refresh the SENSORCACHE, so that the sensors are never read from inside 
+a mesh callback. Every driver is sampled once its interval has passed, so the DHT sensor, which is rate 
+limited and blocks with interrupts disabled while it is read, is only read every SAMPLE_DHTINTERVAL 
+milliseconds. The sampling time of every driver is measured, and a driver whose longest sampling time 
+does not fit in the SAMPLE_BUDGET left in a run is deferred to the next run, so that expensive drivers 
+are not sampled back to back.
+*/
+void runsensorsampling()
+{
+    uint32_t now = millis(); uint32_t spent = 0;
+    for (uint8_t index = 0; index < SENSORDRIVERCOUNT; index++) {
+        // Sample the driver if its sensor is attached and its interval has passed
+        if (!DRIVERATTACHED(index)) {continue;}
+        if (SENSORSAMPLED && now - DRIVERSAMPLETIME[index] < SENSORDRIVERS[index].interval) {continue;}
+        // Defer the driver if it does not fit the budget left in this run
+        if (SENSORSAMPLED && spent > 0 && spent + DRIVERSTATS[index].maxmicros > SAMPLE_BUDGET) {continue;}
+
+        uint32_t started = micros();
+        SENSORDRIVERS[index].sample(SENSORCACHE);
+        uint32_t elapsed = micros() - started;
+        recordelapsed(DRIVERSTATS[index], elapsed);
+        spent += elapsed;
+        DRIVERSAMPLETIME[index] = now;
+    }
+    SENSORSAMPLED = true;
+}
+
+// A function that returns the age in milliseconds of the oldest sensor value in the SENSORCACHE.
+uint32_t sensorcacheage()
+{
+    uint32_t now = millis(); uint32_t age = 0;
+    for (uint8_t index = 0; index < SENSORDRIVERCOUNT; index++) {
+        if (DRIVERATTACHED(index) && now - DRIVERSAMPLETIME[index] > age) {age = now - DRIVERSAMPLETIME[index];}
+    }
+    return age;
+}
+
+
+// A function that fills the values of the sensors attached to the node from a sample into the passed message.
+void fillsensordata(MeshFrame &message, SensorSample &sample)
+{
+    for (uint8_t index = 0; index < SENSORDRIVERCOUNT; index++) {
+        if (DRIVERATTACHED(index)) {SENSORDRIVERS[index].report(message, sample);}
+    }
+}
+
+
+/*
+A function that returns the node that the reply to a meshcommand is sent to. This is the MESHCONTROLNODE, 
+or the origin of the command if the handshakeACK has not been received yet, so that a command that 
+arrives before the handshake completes is still answered to the control node and tracked for retransmission.
+*/
+uint32_t replydestination(MeshFrame &commandmessage)
+{
+    return (MESHCONTROLNODE > 0) ? MESHCONTROLNODE : commandmessage.origin;
+}
+
+// A function that sends the values of a cached sample as a 'sensordata' message to a node with the ping ID.
+void sendsensordata(SensorSample &sample, const char *pingid, uint32_t destination = MESHCONTROLNODE)
+{
+    // Create the sensordata message unicast to the destination with the ping ID
+    PooledFrame sensordata;
+    if (!sensordata.valid()) {return;}
+    sensordata->begin(IMC_SENSORDATA, IMC_UNICAST, mesh.getNodeId(), destination, pingid);
+    // Fill in the sensordata readings and the age of the oldest reading
+    fillsensordata(*sensordata, sample);
+    sensordata->addu32(IMC_SENSOR_AGE, sensorcacheage());
+    sensordata->addu32(IMC_FIELD_CONFIGHASH, CONFIGHASH);
+    // Transmit the sensordata
+    sendmeshmessage(*sensordata);
+}
+
+
+/*
+A command handler that responds to the command 'readsensors'.
+The runtime fills in the cached sensor readings based on the hardware configuration values,
+wraps it into a 'sensordata' message and sends it to the replydestination() of the command.
+The sensors are not read here, so the reply does not stall the mesh callback it runs in.
+*/
+void handlecommand_readsensors(MeshFrame &commandmessage)
+{
+    // Send the cached sensordata with the ping ID of the command
+    sendsensordata(SENSORCACHE, commandmessage.ping, replydestination(commandmessage));
+}
+
+
+// The last sample reported by the push reporting runtime and the time it was reported.
+SensorSample LASTREPORT;
+uint32_t LASTREPORTTIME = 0;
+bool REPORTED = false;
+
+// A function that checks if a value has crossed a threshold in either direction. A threshold of 0 is disabled.
+bool crossedthreshold(float previous, float current, float threshold)
+{
+    return (threshold > 0) && ((previous >= threshold) != (current >= threshold));
+}
+
+/*
+A function that checks a new sample against the last reported sample and returns the reason to 
+report it as a ping ID, or NULL if it does not need to be reported.
+A sample is reported as an alarm if TEM or GAS crosses its threshold or FLM changes, as a delta 
+if any value changed by more than its REPORT_ delta, and as a heartbeat if nothing has been 
+reported for REPORT_HEARTBEAT milliseconds.
+*/
+const char *checksensorreport(SensorSample &sample)
+{
+    // Report the first sample unconditionally
+    if (!REPORTED) {return "push-heartbeat";}
+
+    // Check the thresholds and the flame sensor
+    if (DHTATTACHED && crossedthreshold(LASTREPORT.tem, sample.tem, TEMTHRESHOLD)) {return "push-alarm";}
+    if (GASATTACHED && crossedthreshold(LASTREPORT.gas, sample.gas, GASTHRESHOLD)) {return "push-alarm";}
+    if (FLMATTACHED && LASTREPORT.flm != sample.flm) {return "push-alarm";}
+
+    // Check the deltas
+    if (DHTATTACHED && fabs(sample.hum - LASTREPORT.hum) > REPORT_HUMDELTA) {return "push-delta";}
+    if (DHTATTACHED && fabs(sample.tem - LASTREPORT.tem) > REPORT_TEMDELTA) {return "push-delta";}
+    if (GASATTACHED && abs((int)sample.gas - (int)LASTREPORT.gas) > REPORT_GASDELTA) {return "push-delta";}
+
+    // Check the heartbeat
+    if (millis() - LASTREPORTTIME >= REPORT_HEARTBEAT) {return "push-heartbeat";}
+    return NULL;
+}
+
+/*
+A function that runs the push reporting runtime. Called by the reporttask on the meshScheduler 
+every REPORTINTERVAL milliseconds. The cached sensor sample is sent to the 
+MESHCONTROLNODE as 'sensordata' if checksensorreport() finds a reason to report it.
+Samples are not reported until the handshake with the control node has completed.
+*/
+void runsensorreport()
+{
+    // Wait for the MESHCONTROLNODE value to be acquired
+    if (MESHCONTROLNODE == 0) {return;}
+
+    // Check if the cached sample has to be reported
+    SensorSample sample = SENSORCACHE;
+    const char *reason = checksensorreport(sample);
+    if (reason == NULL) {return;}
+
+    // Send the sample and remember it as the last report
+    sendsensordata(sample, reason);
+    LASTREPORT = sample;
+    LASTREPORTTIME = millis();
+    REPORTED = true;
+}
+
+
+// Sensor History Configuration Values
+#define HISTORY_SIZE 128
+#define HISTORY_INTERVAL 10000
+#define HISTORY_SAMPLESIZE 11
+#define HISTORY_CHUNK 10
+#define HISTORY_REPLYINTERVAL 20
+#define HISTORY_NOVALUE 0xFFFF
+#define HISTORY_NOTEMPERATURE 0x8000
+#define HISTORY_NOFLAME 0xFF
+
+/*
+A ring buffer of the sensor samples of the node, stored in the packed form that is sent on the mesh.
+Each sample is [time:u32][hum:u16][tem:i16][gas:u16][flm:u8] in little-endian order. The time is the
+mesh node time in microseconds, HUM and TEM are in tenths and missing values are stored as HISTORY_NO*.
+*/
+uint8_t HISTORY[HISTORY_SIZE][HISTORY_SAMPLESIZE];
+uint16_t HISTORYHEAD = 0;
+uint16_t HISTORYCOUNT = 0;
+
+// A function that writes an unsigned integer of the given byte width into a buffer in little-endian order.
+void packuint(uint8_t *buffer, uint32_t value, uint8_t width)
+{
+    for (uint8_t i = 0; i < width; i++) {buffer[i] = (value >> (8 * i)) & 0xFF;}
+}
+
+// A function that reads an unsigned integer of the given byte width from a buffer in little-endian order.
+uint32_t unpackuint(const uint8_t *buffer, uint8_t width)
+{
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < width; i++) {value |= (uint32_t)buffer[i] << (8 * i);}
+    return value;
+}
+
+// A function that packs a sample with its timestamp into the next slot of the history ring buffer.
+void storesensorhistory(SensorSample &sample, uint32_t time)
+{
+    uint8_t *slot = HISTORY[HISTORYHEAD];
+    packuint(slot, time, 4);
+    packuint(slot + 4, (DHTATTACHED && !isnan(sample.hum)) ? (uint16_t)lroundf(sample.hum * 10) : HISTORY_NOVALUE, 2);
+    packuint(slot + 6, (DHTATTACHED && !isnan(sample.tem)) ? (uint16_t)(int16_t)lroundf(sample.tem * 10) : HISTORY_NOTEMPERATURE, 2);
+    packuint(slot + 8, (GASATTACHED) ? sample.gas : HISTORY_NOVALUE, 2);
+    packuint(slot + 10, (FLMATTACHED) ? sample.flm : HISTORY_NOFLAME, 1);
+
+    // Advance the head and overwrite the oldest sample once the buffer is full
+    HISTORYHEAD = (HISTORYHEAD + 1) % HISTORY_SIZE;
+    if (HISTORYCOUNT < HISTORY_SIZE) {HISTORYCOUNT++;}
+}
+
+// A function that returns the sample at the given position of the history, counted from the oldest sample.
+const uint8_t *gethistorysample(uint16_t position)
+{
+    return HISTORY[(HISTORYHEAD + HISTORY_SIZE - HISTORYCOUNT + position) % HISTORY_SIZE];
+}
+
+/*
+A function that checks if a history sample was taken after the given node time. A time of 0 matches every sample.
+The comparison is wraparound safe for samples within 35 minutes of the time, which covers the whole buffer.
+*/
+bool historysampleafter(const uint8_t *sample, uint32_t since)
+{
+    return (since == 0) || ((int32_t)(unpackuint(sample, 4) - since) > 0);
+}
+
+/*
+A function that runs the sensor history runtime. Called by the historytask on the meshScheduler 
+every HISTORY_INTERVAL milliseconds to sample the sensors into the history ring buffer.
+*/
+void runsensorhistory()
+{
+    storesensorhistory(SENSORCACHE, mesh.getNodeTime());
+}
+
+// A structure that holds a 'readhistory' reply being sent a chunk at a time by the history reply task.
+struct HistoryReply
+{
+    bool active;
+    char ping[IMC_MAXPING + 1];
+    uint32_t destination;
+    uint32_t since;
+    uint16_t matching;
+    uint16_t position;
+    uint16_t sent;
+    uint8_t chunk;
+};
+
+// Global History Reply
+HistoryReply HISTORYREPLY;
+
+/*
+A function that sends the next chunk of the history reply. Runs on the history reply task every 
+HISTORY_REPLYINTERVAL milliseconds and sends a chunk only when the retransmit window has a free slot, 
+so that every chunk of a full history is tracked by the reliable unicast layer.
+*/
+void runhistoryreply()
+{
+    if (!HISTORYREPLY.active) {
+        historyreplytask.disable();
+        return;
+    }
+    if (RELIABLE_UNICAST && !reliablewindowfree()) {return;}
+
+    // Collect the next chunk of matching samples
+    uint8_t samples[HISTORY_CHUNK * HISTORY_SAMPLESIZE];
+    uint8_t count = 0;
+    while (HISTORYREPLY.position < HISTORYCOUNT && count < HISTORY_CHUNK) {
+        const uint8_t *sample = gethistorysample(HISTORYREPLY.position++);
+        if (!historysampleafter(sample, HISTORYREPLY.since)) {continue;}
+        memcpy(samples + count * HISTORY_SAMPLESIZE, sample, HISTORY_SAMPLESIZE);
+        count++;
+    }
+    HISTORYREPLY.sent += count;
+    bool last = HISTORYREPLY.sent >= HISTORYREPLY.matching;
+
+    // Create the historydata message unicast to the Control Node with the ping ID
+    PooledFrame historydata;
+    if (!historydata.valid()) {return;}
+    historydata->begin(IMC_HISTORYDATA, IMC_UNICAST, mesh.getNodeId(), HISTORYREPLY.destination, HISTORYREPLY.ping);
+    // Fill in the chunk number, the last chunk flag and the packed samples
+    historydata->addu8(IMC_HISTORY_CHUNK, HISTORYREPLY.chunk++);
+    historydata->addbool(IMC_HISTORY_LAST, last);
+    historydata->addbytes(IMC_HISTORY_SAMPLES, samples, count * HISTORY_SAMPLESIZE);
+
+    // Transmit the historydata and end the reply after the last chunk
+    sendmeshmessage(*historydata);
+    if (last) {HISTORYREPLY.active = false;}
+}
+
+/*
+A command handler that responds to the command 'readhistory'.
+The runtime sends every sample in the history taken after the 'since' node time of the command to the 
+replydestination() as 'historydata' messages of up to HISTORY_CHUNK samples each, paced by the history reply 
+task. The chunks are numbered from 0 and the last chunk is flagged. A single empty chunk is sent if there 
+are no matching samples. A new command replaces a reply that is still being sent.
+*/
+void handlecommand_readhistory(MeshFrame &commandmessage)
+{
+    // Determine the node time to send samples from
+    HISTORYREPLY.since = commandmessage.getuint(IMC_FIELD_SINCE, 0);
+    strcpy(HISTORYREPLY.ping, commandmessage.ping);
+    HISTORYREPLY.destination = replydestination(commandmessage);
+
+    // Count the matching samples to know which chunk is the last
+    HISTORYREPLY.matching = 0;
+    for (uint16_t i = 0; i < HISTORYCOUNT; i++) {
+        if (historysampleafter(gethistorysample(i), HISTORYREPLY.since)) {HISTORYREPLY.matching++;}
+    }
+
+    // Start the reply with the first chunk
+    HISTORYREPLY.position = 0;
+    HISTORYREPLY.sent = 0;
+    HISTORYREPLY.chunk = 0;
+    HISTORYREPLY.active = true;
+    historyreplytask.enable();
+}
+
+
+// A function that fills the hardware configuration values of the node into the passed message.
+void fillconfigdata(MeshFrame &message)
+{
+    // Fill in the sensor configuration values of every driver. The node id is carried by the message origin.
+    for (uint8_t index = 0; index < SENSORDRIVERCOUNT; index++) {
+        SENSORDRIVERS[index].config(message);
+    }
+    // Fill in the other hardware configuration values
+    message.addbool(IMC_CONFIG_PINGER, PINGER);
+    message.addu8(IMC_CONFIG_PINGERPIN, PINGERPIN);
+    message.addu32(IMC_CONFIG_SERIALBAUD, SERIALBAUD);
+    message.addu8(IMC_CONFIG_CONNECTLEDPIN, CONNECTLEDPIN);
+    message.addu32(IMC_CONFIG_MESHGROUP, MESH_GROUP);
+}
+
+/*
+A function that computes the configuration hash of the node as the FNV-1a hash of the 
+configuration fields of its 'configdata' message. The hash is sent in handshake, sensordata 
+and configdata messages so that the control node only requests configdata when it changes.
+*/
+uint32_t computeconfighash()
+{
+    PooledFrame configdata;
+    if (!configdata.valid()) {return 0;}
+    configdata->begin(IMC_CONFIGDATA, IMC_UNICAST, mesh.getNodeId(), 0, NULL);
+    fillconfigdata(*configdata);
+    return configdata->hashfields();
+}
+
+/*
+A command handler that responds to the command 'readconfig'.
+The runtime fills in the configuration values from the hardware configuration values,
+wraps it into a 'configdata' message with the configuration hash and sends it to the replydestination() of the command.
+*/
+void handlecommand_readconfig(MeshFrame &commandmessage)
+{
+    // Create the configdata message unicast to the Control Node with the ping ID
+    PooledFrame configdata;
+    if (!configdata.valid()) {return;}
+    configdata->begin(IMC_CONFIGDATA, IMC_UNICAST, mesh.getNodeId(), replydestination(commandmessage), commandmessage.ping);
+
+    // Fill in the configuration values and the configuration hash
+    fillconfigdata(*configdata);
+    configdata->addu32(IMC_FIELD_CONFIGHASH, CONFIGHASH);
+
+    // Transmit the configdata
+    sendmeshmessage(*configdata);
+}
+
+
+// Node Registry Configuration Values
+#define NODEREGISTRY_SIZE 256
+#define NODELIST_CHUNK 16
+
+// A structure that holds what the control node knows about a single node of the mesh.
+struct NodeRecord
+{
+    uint32_t node;
+    uint32_t lastseen;
+    uint32_t confighash;
+    uint32_t configrequested;
+    uint32_t mcastgroup;
+    uint16_t rtt;
+    uint8_t tag;
+    bool connected;
+};
+
+// The node registry of the control node, allocated by allocatecontroltables()
+NodeRecord *NODEREGISTRY = NULL;
+uint16_t NODEREGISTRYCOUNT = 0;
+
+// A function that returns the registry record of a node or NULL if it has none.
+NodeRecord *findnoderecord(uint32_t node)
+{
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (NODEREGISTRY[i].node == node) {return &NODEREGISTRY[i];}
+    }
+    return NULL;
+}
+
+// A function that returns the registry record of a node, adding one if needed. Returns NULL if the registry is full or not allocated.
+NodeRecord *getnoderecord(uint32_t node)
+{
+    NodeRecord *found = findnoderecord(node);
+    if (found != NULL) {return found;}
+    if (NODEREGISTRY == NULL || NODEREGISTRYCOUNT >= NODEREGISTRY_SIZE) {return NULL;}
+
+    NodeRecord *record = &NODEREGISTRY[NODEREGISTRYCOUNT++];
+    memset(record, 0, sizeof(NodeRecord));
+    record->node = node;
+    return record;
+}
+
+// A function that marks a node as connected and seen now. Called for every message received from a node.
+NodeRecord *seennode(uint32_t node)
+{
+    NodeRecord *record = getnoderecord(node);
+    if (record == NULL) {return NULL;}
+    record->lastseen = millis();
+    record->connected = true;
+    return record;
+}
+
+/*
+A function that reconciles the connected flags of the node registry with the mesh topology.
+This walks the painlessMesh topology with getNodeList(), so it is only called once per coalesced 
+'meshsync' and not for every command that needs the list of nodes.
+*/
+void reconcilenoderegistry()
+{
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {NODEREGISTRY[i].connected = false;}
+    for (uint32_t node : mesh.getNodeList()) {
+        NodeRecord *record = getnoderecord(node);
+        if (record != NULL) {record->connected = true;}
+    }
+}
+
+
+// Config Cache Configuration Values
+#define CONFIGCACHE_SIZE 64
+#define CONFIGCACHE_BYTES 40
+#define CONFIGCACHE_RETRY 10000
+#define CONFIGCACHE_MAXMISSES 8
+#define CONFIGCACHE_REPLYINTERVAL 20
+#define CONFIGCACHE_LOGSPACE 448
+
+/*
+A structure that holds the 'configdata' fields of a config hash. The configdata fields carry no node 
+specific values, so the cache is keyed by the config hash and nodes with the same config share an 
+entry. The node registry holds the hash each node last reported.
+*/
+struct ConfigCacheEntry
+{
+    uint32_t hash;
+    uint32_t lastused;
+    uint8_t length;
+    uint8_t bytes[CONFIGCACHE_BYTES];
+};
+
+// The config cache of the control node, allocated by allocatecontroltables()
+ConfigCacheEntry *CONFIGCACHE = NULL;
+uint8_t CONFIGCACHECOUNT = 0;
+uint32_t CONFIGCACHEHITS = 0;
+uint32_t CONFIGCACHEMISSES = 0;
+uint32_t CONFIGCACHEEVICTIONS = 0;
+
+// Forward declaration of the 'readconfig' command sender
+void sendcommand_readconfig(uint32_t node, const char *pingid);
+
+// A function that returns the config cache entry of a config hash or NULL if it is not cached.
+ConfigCacheEntry *findconfigcache(uint32_t hash)
+{
+    if (hash == 0) {return NULL;}
+    for (uint8_t i = 0; i < CONFIGCACHECOUNT; i++) {
+        if (CONFIGCACHE[i].hash == hash) {return &CONFIGCACHE[i];}
+    }
+    return NULL;
+}
+
+/*
+A function that returns the config cache entry of a config hash, adding one if needed. Once the cache 
+is full, the least recently used entry is evicted for it. Returns NULL if the cache is not allocated.
+*/
+ConfigCacheEntry *getconfigcache(uint32_t hash)
+{
+    ConfigCacheEntry *found = findconfigcache(hash);
+    if (found != NULL) {return found;}
+    if (CONFIGCACHE == NULL) {return NULL;}
+
+    ConfigCacheEntry *entry = NULL;
+    if (CONFIGCACHECOUNT < CONFIGCACHE_SIZE) {
+        entry = &CONFIGCACHE[CONFIGCACHECOUNT++];
+    } else {
+        // Evict the least recently used entry
+        entry = &CONFIGCACHE[0];
+        for (uint8_t i = 1; i < CONFIGCACHECOUNT; i++) {
+            if (millis() - CONFIGCACHE[i].lastused > millis() - entry->lastused) {entry = &CONFIGCACHE[i];}
+        }
+        CONFIGCACHEEVICTIONS++;
+    }
+    memset(entry, 0, sizeof(ConfigCacheEntry));
+    entry->hash = hash;
+    entry->lastused = millis();
+    return entry;
+}
+
+// A function that returns the cached config of the hash a node last reported or NULL if it has none. Changes neither table.
+ConfigCacheEntry *findnodeconfig(uint32_t node)
+{
+    NodeRecord *record = findnoderecord(node);
+    if (record == NULL) {return NULL;}
+    ConfigCacheEntry *entry = findconfigcache(record->confighash);
+    return (entry != NULL && entry->length > 0) ? entry : NULL;
+}
+
+// A function that returns true if the config hash a node last reported is in the config cache. Changes neither table.
+bool isconfigcached(uint32_t node)
+{
+    return findnodeconfig(node) != NULL;
+}
+
+/*
+A function that checks the config hash reported by a node in a 'handshake' or 'sensordata' message.
+The hash is stored in the node registry and if no config with the hash is cached, a 'readconfig' 
+command is sent to the node. Requests are spaced by CONFIGCACHE_RETRY so that a node that does 
+not reply is not asked again with every message. A hash of 0 is sent by older nodes and is ignored.
+*/
+void checkconfighash(uint32_t node, uint32_t hash)
+{
+    if (hash == 0) {return;}
+    NodeRecord *record = getnoderecord(node);
+    if (record == NULL) {return;}
+    record->confighash = hash;
+
+    // Check the config cache for the hash
+    ConfigCacheEntry *entry = findconfigcache(hash);
+    if (entry != NULL && entry->length > 0) {entry->lastused = millis(); return;}
+    if (record->configrequested != 0 && millis() - record->configrequested < CONFIGCACHE_RETRY) {return;}
+
+    // Request the full config from the node
+    record->configrequested = millis();
+    sendcommand_readconfig(node, "configsync");
+}
+
+// A function that stores the config fields of a 'configdata' message into the config cache under its config hash.
+void storeconfigcache(MeshFrame &configdata)
+{
+    uint32_t hash = configdata.getuint(IMC_FIELD_CONFIGHASH, 0);
+    if (hash == 0) {return;}
+    // Record the hash for nodes that only report it with their configdata
+    NodeRecord *record = getnoderecord(configdata.origin);
+    if (record != NULL) {record->confighash = hash; record->configrequested = 0;}
+
+    ConfigCacheEntry *entry = getconfigcache(hash);
+    if (entry == NULL) {return;}
+    entry->length = configdata.copyfields(entry->bytes, CONFIGCACHE_BYTES);
+    entry->lastused = millis();
+}
+
+
+/*
+A control command handler that responds to the control command 'readconfig-control'.
+Accumulates the relevant configuration values for the hardware and mesh into a 
+meshlog of type 'controlconfigdata' and logs it to the Serial.
+*/
+void handlecontrolcommand_readconfig(JsonDocument &controlcommand) 
+{
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("controlconfigdata", "control config data received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = mesh.getNodeId();
+
+    // Fill in the hardware configuration values
+    logdoc["logdata"]["config"]["PINGER"] = PINGER;
+    logdoc["logdata"]["config"]["PINGERPIN"] = PINGERPIN;
+    logdoc["logdata"]["config"]["SERIALBAUD"] = SERIALBAUD;
+    logdoc["logdata"]["config"]["CONNECTLEDPIN"] = CONNECTLEDPIN;
+    // Fill in the mesh configuration values
+    logdoc["logdata"]["config"]["MESH_SSID"] = MESH_SSID;
+    logdoc["logdata"]["config"]["MESH_PSWD"] = MESH_PSWD;
+    logdoc["logdata"]["config"]["MESH_PORT"] = MESH_PORT;
+    logdoc["logdata"]["config"]["NODEID"] = mesh.getNodeId();
+
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
+
+/*
+A control command handler that responds to the control command 'readnodelist'.
+Streams the node registry to the Serial in meshlogs of type 'controlnodelist' with up to NODELIST_CHUNK 
+nodes each, so that the list scales to large meshes without a large document. The meshlogs are numbered 
+with a chunk index and the last one is flagged. Every node is logged with its connected flag, the time since
+it was last seen, its config hash, its last round trip time in milliseconds, its group tag and its multicast group.
+*/
+void handlecontrolcommand_nodelist(JsonDocument &controlcommand) 
+{
+    uint16_t position = 0; uint8_t chunk = 0;
+    do {
+        // Create the meshlog document
+        JsonDocument &logdoc = beginmeshlog("controlnodelist", "control nodelist data received", LOGPRIORITY_HIGH);
+        // Fill in the meshlog values
+        logdoc["logdata"]["node"] = mesh.getNodeId();
+        logdoc["logdata"]["total"] = NODEREGISTRYCOUNT;
+        logdoc["logdata"]["chunk"] = chunk++;
+        logdoc["logdata"]["last"] = (position + NODELIST_CHUNK >= NODEREGISTRYCOUNT);
+        // Log the document to the Serial port and leave it open for the nodes
+        if (!openmeshlog(logdoc)) {return;}
+
+        // Stream the nodes of the chunk
+        LOGSINK.print(",\"nodes\":[");
+        uint32_t now = millis();
+        for (uint16_t i = position; i < NODEREGISTRYCOUNT && i < position + NODELIST_CHUNK; i++) {
+            NodeRecord &record = NODEREGISTRY[i];
+
+            // Fill the node into a small document and log it to the Serial port
+            StaticJsonDocument<JSON_OBJECT_SIZE(12)> nodedoc;
+            nodedoc["node"] = record.node;
+            nodedoc["connected"] = record.connected;
+            nodedoc["lastseen"] = now - record.lastseen;
+            nodedoc["confighash"] = record.confighash;
+            nodedoc["rtt"] = record.rtt;
+            nodedoc["tag"] = record.tag;
+            nodedoc["mcastgroup"] = record.mcastgroup;
+
+            if (i > position) {LOGSINK.print(",");}
+            serializeJson(nodedoc, LOGSINK);
+        }
+        LOGSINK.print("]");
+
+        // Complete the meshlog
+        closemeshlog();
+        position += NODELIST_CHUNK;
+    } while (position < NODEREGISTRYCOUNT);
+}
+
+
+/*
+A control command handler that responds to the control command 'readmemory-control'.
+Accumulates the heap and message pool statistics of the control node into a
+meshlog of type 'controlmemorydata' and logs it to the Serial.
+*/
+void handlecontrolcommand_memory(JsonDocument &controlcommand)
+{
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("controlmemorydata", "control memory data received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = mesh.getNodeId();
+
+    // Fill in the heap and pool statistics
+    logdoc["logdata"]["memory"]["FREEHEAP"] = readfreeheap();
+    logdoc["logdata"]["memory"]["HEAPLOWWATER"] = HEAPLOWWATER;
+    logdoc["logdata"]["memory"]["FRAMEPOOLSIZE"] = FRAMEPOOLSIZE;
+    logdoc["logdata"]["memory"]["FRAMEPOOLPEAK"] = FRAMEPOOLPEAK;
+    logdoc["logdata"]["memory"]["POOLEXHAUSTED"] = POOLEXHAUSTED;
+    logdoc["logdata"]["memory"]["LOGDROPPED"] = LOGSINK.dropped();
+    logdoc["logdata"]["memory"]["LOGSTALLS"] = LOGSINK.stalls;
+
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
+
+
+// Loop Profiler Configuration Values
+#define PROFILE_BUCKETS 16
+#define PROFILE_BUCKETSHIFT 7
+#define PROFILE_STAGESIZE 17
+
+// The stages of the update() loop that are profiled, with the whole loop as the last stage.
+enum profilestage : uint8_t {
+    PROFILE_MESH = 0,
+    PROFILE_CONTROLLER = 1,
+    PROFILE_BATCH = 2,
+    PROFILE_LED = 3,
+    PROFILE_PINGER = 4,
+    PROFILE_LOGSINK = 5,
+    PROFILE_LOOP = 6
+};
+const char *const PROFILESTAGES[] = {"mesh", "controller", "batch", "led", "pinger", "logsink", "loop"};
+
+#if LOOPPROFILER
+/*
+A structure that holds the CPU cycle statistics of a stage of the update() loop. The cycle counts are
+recorded into a histogram of PROFILE_BUCKETS power of two buckets, where bucket b holds the counts below
+2^(b + PROFILE_BUCKETSHIFT + 1) cycles and the last bucket holds all the longer counts.
+*/
+struct ProfileStage
+{
+    uint32_t count;
+    uint32_t mincycles;
+    uint32_t maxcycles;
+    uint64_t totalcycles;
+    uint32_t buckets[PROFILE_BUCKETS];
+};
+
+// The loop profiler state
+ProfileStage PROFILE[TABLESIZE(PROFILESTAGES)];
+uint32_t LOOPWINDOWSTART = 0;
+uint32_t LOOPWINDOWCOUNT = 0;
+uint32_t LOOPFREQUENCY = 0;
+uint32_t LONGESTSTALL = 0;
+uint32_t LONGESTSTALLTIME = 0;
+
+// A function that records the CPU cycles spent in a stage of the update() loop.
+void recordstage(uint8_t stage, uint32_t cycles)
+{
+    ProfileStage &profile = PROFILE[stage];
+    if (profile.count == 0 || cycles < profile.mincycles) {profile.mincycles = cycles;}
+    if (cycles > profile.maxcycles) {profile.maxcycles = cycles;}
+    profile.count++;
+    profile.totalcycles += cycles;
+
+    // Find the histogram bucket from the highest bit of the cycle count
+    uint8_t bucket = 0;
+    uint32_t scaled = cycles >> PROFILE_BUCKETSHIFT;
+    while (scaled > 1 && bucket < PROFILE_BUCKETS - 1) {scaled >>= 1; bucket++;}
+    profile.buckets[bucket]++;
+}
+
+// A function that records the CPU cycles of a whole update() loop, the loop frequency and the longest loop since boot.
+void recordloop(uint32_t cycles)
+{
+    recordstage(PROFILE_LOOP, cycles);
+    if (cycles > LONGESTSTALL) {LONGESTSTALL = cycles; LONGESTSTALLTIME = millis();}
+
+    // Compute the loop frequency over windows of a second
+    LOOPWINDOWCOUNT++;
+    uint32_t elapsed = millis() - LOOPWINDOWSTART;
+    if (elapsed >= 1000) {
+        LOOPFREQUENCY = LOOPWINDOWCOUNT * 1000 / elapsed;
+        LOOPWINDOWCOUNT = 0;
+        LOOPWINDOWSTART += elapsed;
+    }
+}
+
+// A function that returns the 99th percentile of the cycle counts of a stage as the upper bound of its histogram bucket.
+uint32_t stagepercentile(ProfileStage &profile)
+{
+    uint32_t target = profile.count - profile.count / 100; uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < PROFILE_BUCKETS - 1; bucket++) {
+        seen += profile.buckets[bucket];
+        if (seen >= target) {
+            uint32_t bound = (uint32_t)1 << (bucket + PROFILE_BUCKETSHIFT + 1);
+            return (bound < profile.maxcycles) ? bound : profile.maxcycles;
+        }
+    }
+    return profile.maxcycles;
+}
+
+// Macros that measure a stage and a whole loop of update() in CPU cycles.
+#define PROFILELOOPBEGIN() uint32_t loopstarted = readcyclecount()
+#define PROFILELOOPEND() recordloop(readcyclecount() - loopstarted)
+#define PROFILESTAGE(stage, call) {uint32_t stagestarted = readcyclecount(); call; recordstage(stage, readcyclecount() - stagestarted);}
+#else
+#define PROFILELOOPBEGIN()
+#define PROFILELOOPEND()
+#define PROFILESTAGE(stage, call) {call;}
+#endif
+
+/*
+A function that fills the loop profile of the node into a 'profiledata' message. Every stage that has been 
+run is added with its minimum, average, maximum and 99th percentile CPU cycles, along with the loop 
+frequency, the heap, the longest loop since boot in cycles and its age in milliseconds, and the CPU frequency.
+Only the heap is filled in when the profiler is compiled out.
+*/
+void fillprofiledata(MeshFrame &message)
+{
+#if LOOPPROFILER
+    for (uint8_t stage = 0; stage < TABLESIZE(PROFILESTAGES); stage++) {
+        ProfileStage &profile = PROFILE[stage];
+        if (profile.count == 0) {continue;}
+
+        uint8_t values[PROFILE_STAGESIZE];
+        uint32_t stats[4] = {profile.mincycles, (uint32_t)(profile.totalcycles / profile.count), profile.maxcycles, stagepercentile(profile)};
+        values[0] = stage;
+        for (uint8_t i = 0; i < 4; i++) {packuint(values + 1 + i * 4, stats[i], 4);}
+        message.addbytes(IMC_PROFILE_STAGE, values, PROFILE_STAGESIZE);
+    }
+    message.addu32(IMC_PROFILE_FREQUENCY, LOOPFREQUENCY);
+    message.addu32(IMC_PROFILE_STALL, LONGESTSTALL);
+    message.addu32(IMC_PROFILE_STALLAGE, millis() - LONGESTSTALLTIME);
+    message.addu8(IMC_PROFILE_CPUMHZ, readcpumhz());
+#endif
+    message.addu32(IMC_PROFILE_FREEHEAP, readfreeheap());
+    message.addu32(IMC_PROFILE_HEAPLOWWATER, HEAPLOWWATER);
+}
+
+/*
+A function that logs the loop profile in a 'profiledata' message as a meshlog of the given type to the Serial.
+The stages are logged as an object that maps each stage name to its [min, avg, max, p99] CPU cycles.
+*/
+void logprofiledata(MeshFrame &profiledata, const char *logtype)
+{
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog(logtype, "profile data received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = profiledata.origin;
+    logdoc["logdata"]["ping"] = profiledata.ping;
+
+    // Fill in the stages and the other profile values
+    JsonObject stages = logdoc["logdata"].createNestedObject("stages");
+    uint16_t cursor = 0; MeshField field;
+    while (profiledata.nextfield(cursor, field)) {
+        if (field.id == IMC_PROFILE_STAGE && field.kind == IMC_KIND_BYTES && field.uintvalue == PROFILE_STAGESIZE) {
+            if (field.data[0] >= TABLESIZE(PROFILESTAGES)) {continue;}
+            JsonArray values = stages.createNestedArray(PROFILESTAGES[field.data[0]]);
+            for (uint8_t i = 0; i < 4; i++) {values.add(unpackuint(field.data + 1 + i * 4, 4));}
+        }
+        else if (field.id == IMC_PROFILE_FREQUENCY) {logdoc["logdata"]["frequency"] = field.uintvalue;}
+        else if (field.id == IMC_PROFILE_FREEHEAP) {logdoc["logdata"]["freeheap"] = field.uintvalue;}
+        else if (field.id == IMC_PROFILE_HEAPLOWWATER) {logdoc["logdata"]["heaplowwater"] = field.uintvalue;}
+        else if (field.id == IMC_PROFILE_STALL) {logdoc["logdata"]["stall"] = field.uintvalue;}
+        else if (field.id == IMC_PROFILE_STALLAGE) {logdoc["logdata"]["stallage"] = field.uintvalue;}
+        else if (field.id == IMC_PROFILE_CPUMHZ) {logdoc["logdata"]["cpumhz"] = field.uintvalue;}
+    }
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
+
+/*
+A command handler that responds to the command 'readprofile'.
+Fills the loop profile of the node into a 'profiledata' message and sends it to the replydestination() of the command.
+*/
+void handlecommand_readprofile(MeshFrame &commandmessage)
+{
+    // Create the profiledata message unicast to the Control Node with the ping ID
+    PooledFrame profiledata;
+    if (!profiledata.valid()) {return;}
+    profiledata->begin(IMC_PROFILEDATA, IMC_UNICAST, mesh.getNodeId(), replydestination(commandmessage), commandmessage.ping);
+    // Fill in the loop profile and transmit the profiledata
+    fillprofiledata(*profiledata);
+    sendmeshmessage(*profiledata);
+}
+
+// A message handler triggered when a 'profiledata' message is received by the control node. Logs it as a meshlog of type 'profiledata'.
+void handlemessage_profiledata(MeshFrame &profiledata)
+{
+    // Validate the message type to be a 'profiledata'
+    if (profiledata.type == IMC_PROFILEDATA) {logprofiledata(profiledata, "profiledata");}
+}
+
+// A function that sends the 'readprofile' command unicast to a node with the ping ID.
+void sendcommand_readprofile(uint32_t node, const char *pingid)
+{
+    // Create the command message unicast to the node
+    PooledFrame requestprofile;
+    if (!requestprofile.valid()) {return;}
+    requestprofile->begin(IMC_MESHCOMMAND, IMC_UNICAST, mesh.getNodeId(), node, pingid);
+    // Fill in the command
+    requestprofile->addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READPROFILE);
+
+    sendmeshmessage(*requestprofile);
+}
+
+// A control command handler that responds to the control command 'readprofile-node'.
+void handlecontrolcommand_readprofilenode(JsonDocument &controlcommand)
+{
+    // Detect the destination node and ping ID
+    uint32_t node = controlcommand["node"].as<uint32_t>();
+    const char *pingid = controlcommand["ping"] | "";
+    // Send the 'readprofile' command
+    sendcommand_readprofile(node, pingid);
+}
+
+// A control command handler that responds to the control command 'readprofile-control'. Logs the loop profile of the control node as a meshlog of type 'controlprofiledata'.
+void handlecontrolcommand_readprofile(JsonDocument &controlcommand)
+{
+    // Fill the loop profile into a frame from the control node
+    PooledFrame profiledata;
+    if (!profiledata.valid()) {return;}
+    profiledata->begin(IMC_PROFILEDATA, IMC_UNICAST, mesh.getNodeId(), mesh.getNodeId(), NULL);
+    fillprofiledata(*profiledata);
+    // Log the loop profile
+    logprofiledata(*profiledata, "controlprofiledata");
+}
+
+
+// Traffic Report Configuration Values
+#ifndef TRAFFIC_REPORTINTERVAL
+#define TRAFFIC_REPORTINTERVAL 0
+#endif
+#define TRAFFIC_ENTRYSIZE 22
+
+// A function that writes a value as a little-endian base 128 varint into a buffer. Returns the number of bytes written.
+uint8_t packvarint(uint8_t *buffer, uint32_t value)
+{
+    uint8_t count = 0;
+    while (value >= 0x80) {buffer[count++] = (value & 0x7F) | 0x80; value >>= 7;}
+    buffer[count++] = value;
+    return count;
+}
+
+// A function that reads a varint from a buffer at the position, advancing it. Reads at most the passed length.
+uint32_t unpackvarint(const uint8_t *buffer, uint8_t length, uint8_t &position)
+{
+    uint32_t value = 0; uint8_t shift = 0;
+    while (position < length && shift < 32) {
+        uint8_t byte = buffer[position++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {break;}
+        shift += 7;
+    }
+    return value;
+}
+
+/*
+A function that fills the traffic counters of the node into a 'nodemetrics' message. Every message type and 
+reach type that has been sent or received is added as a bytes field with its counters packed as varints, so the 
+report stays compact. Entries that do not fit the frame are skipped and the report is flagged as truncated.
+*/
+void filltrafficdata(MeshFrame &message)
+{
+    // Fill in the receive and uptime counters
+    message.addu32(IMC_TRAFFIC_RXINVALID, RXINVALID);
+    message.addu32(IMC_TRAFFIC_RXUNHANDLED, RXUNHANDLED);
+    message.addu32(IMC_TRAFFIC_RXFILTERED, RXFILTERED);
+    message.addu32(IMC_TRAFFIC_UPTIME, millis());
+
+    // Fill in the counters of every message type and reach type that has traffic, keeping room for the flag and a sequence field
+    bool truncated = false;
+    for (uint8_t type = 0; type < TABLESIZE(MESSAGETYPES); type++) {
+        for (uint8_t reach = 0; reach < TABLESIZE(REACHTYPES); reach++) {
+            TrafficCounters &counters = TRAFFIC[type][reach];
+            if (counters.txframes == 0 && counters.rxframes == 0) {continue;}
+
+            uint8_t values[TRAFFIC_ENTRYSIZE]; uint8_t count = 0;
+            values[count++] = type;
+            values[count++] = reach;
+            count += packvarint(values + count, counters.txframes);
+            count += packvarint(values + count, counters.txbytes);
+            count += packvarint(values + count, counters.rxframes);
+            count += packvarint(values + count, counters.rxbytes);
+            if (message.space() < count + 2 + 2 + 3) {truncated = true; continue;}
+            message.addbytes(IMC_TRAFFIC_TYPE, values, count);
+        }
+    }
+    if (truncated) {message.addbool(IMC_TRAFFIC_TRUNCATED, true);}
+}
+
+/*
+A function that logs the traffic counters in a 'nodemetrics' message as a meshlog of the given type to the Serial.
+The message types are logged as an object that maps each type name to an object that maps each reach name 
+to its [txframes, txbytes, rxframes, rxbytes].
+*/
+void logtrafficdata(MeshFrame &nodemetrics, const char *logtype)
+{
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog(logtype, "node metrics received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = nodemetrics.origin;
+    logdoc["logdata"]["ping"] = nodemetrics.ping;
+    logdoc["logdata"]["truncated"] = false;
+
+    // Fill in the message types and the other counters
+    JsonObject types = logdoc["logdata"].createNestedObject("types");
+    uint16_t cursor = 0; MeshField field;
+    while (nodemetrics.nextfield(cursor, field)) {
+        switch (field.id) {
+            case IMC_TRAFFIC_TYPE: {
+                if (field.kind != IMC_KIND_BYTES || field.uintvalue < 2) {break;}
+                uint8_t length = field.uintvalue; uint8_t position = 2;
+                const char *messagename = lookupname(MESSAGETYPES, TABLESIZE(MESSAGETYPES), field.data[0]);
+                JsonObject reaches = types[messagename];
+                if (reaches.isNull()) {reaches = types.createNestedObject(messagename);}
+                JsonArray values = reaches.createNestedArray(lookupname(REACHTYPES, TABLESIZE(REACHTYPES), field.data[1]));
+                for (uint8_t i = 0; i < 4; i++) {values.add(unpackvarint(field.data, length, position));}
+                break;
+            }
+            case IMC_TRAFFIC_RXINVALID: logdoc["logdata"]["invalid"] = field.uintvalue; break;
+            case IMC_TRAFFIC_RXUNHANDLED: logdoc["logdata"]["unhandled"] = field.uintvalue; break;
+            case IMC_TRAFFIC_RXFILTERED: logdoc["logdata"]["filtered"] = field.uintvalue; break;
+            case IMC_TRAFFIC_UPTIME: logdoc["logdata"]["uptime"] = field.uintvalue; break;
+            case IMC_TRAFFIC_TRUNCATED: logdoc["logdata"]["truncated"] = true; break;
+            default: break;
+        }
+    }
+    // Flag the meshlog as truncated if the counters did not fit the document
+    if (logdoc.overflowed()) {logdoc["logdata"]["truncated"] = true;}
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
+
+// A function that sends the traffic counters of the node as a 'nodemetrics' message to a node with the ping ID.
+void sendtrafficdata(const char *pingid, uint32_t destination)
+{
+    // Create the nodemetrics message unicast to the destination with the ping ID
+    PooledFrame nodemetrics;
+    if (!nodemetrics.valid()) {return;}
+    nodemetrics->begin(IMC_NODEMETRICS, IMC_UNICAST, mesh.getNodeId(), destination, pingid);
+    // Fill in the traffic counters and transmit the nodemetrics
+    filltrafficdata(*nodemetrics);
+    sendmeshmessage(*nodemetrics);
+}
+
+// A command handler that responds to the command 'readtraffic' with a 'nodemetrics' message.
+void handlecommand_readtraffic(MeshFrame &commandmessage)
+{
+    sendtrafficdata(commandmessage.ping, replydestination(commandmessage));
+}
+
+/*
+A function that runs the traffic report runtime. Called by the traffictask on the meshScheduler every 
+TRAFFIC_REPORTINTERVAL milliseconds to push the traffic counters to the control node, once it is known.
+*/
+void runtrafficreport()
+{
+    if (MESHCONTROLNODE > 0) {sendtrafficdata("push-metrics", MESHCONTROLNODE);}
+}
+
+// A message handler triggered when a 'nodemetrics' message is received by the control node. Logs it as a meshlog of type 'nodemetrics'.
+void handlemessage_nodemetrics(MeshFrame &nodemetrics)
+{
+    // Validate the message type to be a 'nodemetrics'
+    if (nodemetrics.type == IMC_NODEMETRICS) {logtrafficdata(nodemetrics, "nodemetrics");}
+}
+
+// A function that sends the 'readtraffic' command unicast to a node with the ping ID.
+void sendcommand_readtraffic(uint32_t node, const char *pingid)
+{
+    // Create the command message unicast to the node
+    PooledFrame requesttraffic;
+    if (!requesttraffic.valid()) {return;}
+    requesttraffic->begin(IMC_MESHCOMMAND, IMC_UNICAST, mesh.getNodeId(), node, pingid);
+    // Fill in the command
+    requesttraffic->addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READTRAFFIC);
+
+    sendmeshmessage(*requesttraffic);
+}
+
+// A control command handler that responds to the control command 'readtraffic-node'.
+void handlecontrolcommand_readtrafficnode(JsonDocument &controlcommand)
+{
+    // Detect the destination node and ping ID
+    uint32_t node = controlcommand["node"].as<uint32_t>();
+    const char *pingid = controlcommand["ping"] | "";
+    // Send the 'readtraffic' command
+    sendcommand_readtraffic(node, pingid);
+}
+
+// A control command handler that responds to the control command 'readtraffic-control'. Logs the traffic counters of the control node as a meshlog of type 'controlnodemetrics'.
+void handlecontrolcommand_readtraffic(JsonDocument &controlcommand)
+{
+    // Fill the traffic counters into a frame from the control node
+    PooledFrame nodemetrics;
+    if (!nodemetrics.valid()) {return;}
+    nodemetrics->begin(IMC_NODEMETRICS, IMC_UNICAST, mesh.getNodeId(), mesh.getNodeId(), NULL);
+    filltrafficdata(*nodemetrics);
+    // Log the traffic counters
+    logtrafficdata(*nodemetrics, "controlnodemetrics");
+}
+
+
+// A function pointer type for the 'handlecommand_' runtimes.
+typedef void (*commandhandler)(MeshFrame &commandmessage);
+
+// The command handler table for 'meshcommand' messages, indexed by the IMC command code.
+const commandhandler COMMANDHANDLERS[] = {
+    NULL,                           // IMC_COMMAND_NONE
+    handlecommand_readsensors,      // IMC_COMMAND_READSENSORS
+    handlecommand_readconfig,       // IMC_COMMAND_READCONFIG
+    handlecommand_readhistory,      // IMC_COMMAND_READHISTORY
+    handlecommand_readprofile,      // IMC_COMMAND_READPROFILE
+    handlecommand_readtraffic       // IMC_COMMAND_READTRAFFIC
+};
+
+
+/*
+A message handler triggered when a 'meshcommand' message is received by the node. 
+Calls the appropriate 'handlecommand_' runtime to execute the command instruction. 
+*/
+void handlemessage_meshcommand(MeshFrame &commandmessage)
+{
+    // Validate the message type to be a 'meshcommand'
+    if (commandmessage.type == IMC_MESHCOMMAND) {
+        // Determine the command.
+        uint8_t command = commandmessage.getuint(IMC_FIELD_COMMAND, IMC_COMMAND_NONE);
+
+        // Create the meshlog document
+        JsonDocument &logdoc = beginmeshlog("meshcommandreceived", "command received from the mesh");
+        // Fill in the meshlog values
+        logdoc["logdata"]["command"] = lookupname(COMMANDS, TABLESIZE(COMMANDS), command);
+        // Log the document to the Serial port.
+        endmeshlog(logdoc);
+
+        // Call the appropriate command handler runtime from the command table.
+        if (command < TABLESIZE(COMMANDHANDLERS) && COMMANDHANDLERS[command] != NULL) {
+            COMMANDHANDLERS[command](commandmessage);
+        }
+    }
+}
+
+
+/*
+A message handler triggered when a 'handshake' message is received by the node. 
+Sends a 'handshakeACK' message back to the node that sent the 'handshake' message, sends a 
+'readconfig' command to the same node if its config hash is not cached and finally logs the 
+'handshakerequested' meshlog to the Serial port
+*/
+void handlemessage_handshake(MeshFrame &handshakemessage)
+{
+    // Validate the message type to be a 'handshake'
+    if (handshakemessage.type == IMC_HANDSHAKE) {
+        // Determine the nodeID requesting a handshake
+        uint32_t friendlynode = handshakemessage.origin;
+
+        // Create the handshakeACK message unicast to the node requesting the handshake
+        PooledFrame handshakeACK;
+        if (!handshakeACK.valid()) {return;}
+        handshakeACK->begin(IMC_HANDSHAKEACK, IMC_UNICAST, mesh.getNodeId(), friendlynode, NULL);
+        // Fill in the handshakeACK values
+        handshakeACK->addu32(IMC_FIELD_CONTROLNODE, mesh.getNodeId());
+
+        // Transmit the handshakeACK
+        sendmeshmessage(*handshakeACK);
+
+        // Record the multicast group of the node in the node registry, a node without a group reports none
+        NodeRecord *record = getnoderecord(friendlynode);
+        if (record != NULL) {record->mcastgroup = handshakemessage.getuint(IMC_FIELD_GROUP, 0);}
+
+        // Request the configdata of the node if its config hash is not cached
+        checkconfighash(friendlynode, handshakemessage.getuint(IMC_FIELD_CONFIGHASH, 0));
+
+        // Create the meshlog document
+        JsonDocument &logdoc = beginmeshlog("handshake-rxack", "handshake requested and acknowledged for a node on the mesh", LOGPRIORITY_HIGH);
+        // Fill in the meshlog values
+        logdoc["logdata"]["node"] = friendlynode;
+        // Log the document to the Serial port.
+        endmeshlog(logdoc);
+    }
+}
+
+
+/*
+A message handler triggered when a 'handshakeACK' message is received by the node. 
+Sets the MESHCONTROLNODE global, logs a 'handshakecomplete' meshlog to the Serial.
+*/
+void handlemessage_handshakeACK(MeshFrame &handshakemessage)
+{
+    // Validate the message type to be a 'handshakeACK'
+    if (handshakemessage.type == IMC_HANDSHAKEACK) {
+        // Determine the ControlNodeID from the acknowledgement
+        MESHCONTROLNODE = handshakemessage.getuint(IMC_FIELD_CONTROLNODE, handshakemessage.origin);
+        // Stop the handshake runtime
+        handshaketask.disable();
+        // Send the connection changes that were kept while the control node was unknown
+        connectionupdatetask.disable();
+        flushconnectionupdate();
+
+        // Create the meshlog document
+        JsonDocument &logdoc = beginmeshlog("handshakecomplete", "handshake completed with control node", LOGPRIORITY_HIGH);
+        // Fill in the meshlog values
+        logdoc["logdata"]["controlnode"] = MESHCONTROLNODE;
+        // Log the document to the Serial port.
+        endmeshlog(logdoc);
+    }    
+}
+
+
+// Sensor Batch Configuration Values. The batch holds an entry for every node the registry can hold.
+#define SENSORBATCH_MAXNODES NODEREGISTRY_SIZE
+#define SENSORBATCH_DEADLINE 3000
+#define SENSORBATCH_NOVALUE 0xFF
+#define SENSORBATCH_KEYS (TABLESIZE(SENSORKEYS) - 1)
+#define SENSORBATCH_MISSINGPART 16
+
+// The stages of streaming a sensor batch meshlog
+#define SENSORBATCH_STREAMREADINGS 0
+#define SENSORBATCH_STREAMMISSING 1
+
+/*
+A structure that holds the sensordata reply of a single node in a sensor batch.
+The readings are indexed by their sensor field ID minus 1, as field ID 0 is not a sensor.
+Nodes that were not expected when the batch started are kept for their readings but are not counted as received.
+*/
+struct SensorBatchEntry
+{
+    uint32_t node;
+    bool expected;
+    bool received;
+    uint8_t kinds[SENSORBATCH_KEYS];
+    uint32_t values[SENSORBATCH_KEYS];
+};
+
+// A structure that holds the sensordata replies collected by the control node for a single ping.
+struct SensorBatch
+{
+    bool active;
+    char ping[IMC_MAXPING + 1];
+    uint32_t started;
+    uint32_t deadline;
+    uint16_t expected;
+    uint16_t received;
+    uint16_t late;
+    uint16_t count;
+    uint8_t streamstage;
+    uint16_t streamcursor;
+    bool streamfirst;
+    SensorBatchEntry *entries;
+};
+
+// Global Sensor Batch. Its entries are allocated by allocatecontroltables().
+SensorBatch SENSORBATCH;
+
+
+// A function that adds an entry for a node to the sensor batch. Returns NULL if the batch is full or not allocated.
+SensorBatchEntry *addsensorbatchentry(uint32_t node, bool expected = true)
+{
+    if (SENSORBATCH.entries == NULL || SENSORBATCH.count >= SENSORBATCH_MAXNODES) {return NULL;}
+
+    SensorBatchEntry &entry = SENSORBATCH.entries[SENSORBATCH.count++];
+    entry.node = node;
+    entry.expected = expected;
+    entry.received = false;
+    memset(entry.kinds, SENSORBATCH_NOVALUE, sizeof(entry.kinds));
+    return &entry;
+}
+
+
+/*
+A log stream source that prints the next part of the 'sensordata-batch' meshlog of the sensor batch.
+The readings of the nodes that replied are printed one node per part, followed by the list of nodes that
+did not reply in parts of SENSORBATCH_MISSINGPART nodes. Returns false once the meshlog has been completed.
+*/
+bool streamsensorbatch(Print &output)
+{
+    // Print the reading of the next node that replied
+    if (SENSORBATCH.streamstage == SENSORBATCH_STREAMREADINGS) {
+        if (SENSORBATCH.streamcursor == 0) {output.print(",\"readings\":[");}
+        while (SENSORBATCH.streamcursor < SENSORBATCH.count) {
+            SensorBatchEntry &entry = SENSORBATCH.entries[SENSORBATCH.streamcursor++];
+            if (!entry.received) {continue;}
+
+            // Fill the reading into a small document and print it
+            StaticJsonDocument<JSON_OBJECT_SIZE(16)> readingdoc;
+            readingdoc["node"] = entry.node;
+            JsonObject sensors = readingdoc.createNestedObject("sensors");
+            for (uint8_t key = 0; key < SENSORBATCH_KEYS; key++) {
+                if (entry.kinds[key] == SENSORBATCH_NOVALUE) {continue;}
+                fillfieldvalue(sensors, SENSORKEYS[key + 1], entry.kinds[key], entry.values[key]);
+            }
+
+            if (!SENSORBATCH.streamfirst) {output.print(",");}
+            serializeJson(readingdoc, output);
+            SENSORBATCH.streamfirst = false;
+            return true;
+        }
+
+        // Move on to the nodes that did not reply
+        output.print("],\"missing\":[");
+        SENSORBATCH.streamstage = SENSORBATCH_STREAMMISSING;
+        SENSORBATCH.streamcursor = 0;
+        SENSORBATCH.streamfirst = true;
+    }
+
+    // Print the next nodes that did not reply
+    uint8_t printed = 0;
+    while (SENSORBATCH.streamcursor < SENSORBATCH.count && printed < SENSORBATCH_MISSINGPART) {
+        SensorBatchEntry &entry = SENSORBATCH.entries[SENSORBATCH.streamcursor++];
+        if (entry.received) {continue;}
+        if (!SENSORBATCH.streamfirst) {output.print(",");}
+        output.print(entry.node);
+        SENSORBATCH.streamfirst = false;
+        printed++;
+    }
+    if (SENSORBATCH.streamcursor < SENSORBATCH.count) {return true;}
+
+    // Complete the meshlog
+    output.print("]}}"); output.println();
+    return false;
+}
+
+
+/*
+A function that logs the collected sensor batch as a single meshlog of type 'sensordata-batch' and ends the batch.
+The meshlog carries the readings of every node that replied along with the list of nodes that did not reply.
+It can be far larger than the log sink, so it is streamed to the Serial port a node at a time as the log sink
+drains, and the entries of the batch are kept until the next batch starts.
+*/
+void flushsensorbatch()
+{
+    if (!SENSORBATCH.active) {return;}
+    SENSORBATCH.active = false;
+
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("sensordata-batch", "sensor data batch received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["ping"] = SENSORBATCH.ping;
+    logdoc["logdata"]["expected"] = SENSORBATCH.expected;
+    logdoc["logdata"]["received"] = SENSORBATCH.received;
+    logdoc["logdata"]["late"] = SENSORBATCH.late;
+    logdoc["logdata"]["duration"] = millis() - SENSORBATCH.started;
+
+    // Stream the meshlog to the Serial port with its readings and missing nodes
+    SENSORBATCH.streamstage = SENSORBATCH_STREAMREADINGS;
+    SENSORBATCH.streamcursor = 0;
+    SENSORBATCH.streamfirst = true;
+    streammeshlog(logdoc, streamsensorbatch);
+}
+
+
+/*
+A function that starts collecting the sensordata replies for a ping into an empty sensor batch.
+The expected nodes are added to the batch with addsensorbatchentry() and the batch is logged
+when all of them have replied or when the deadline (in milliseconds) has passed.
+A batch that is still being collected is logged before the new batch is started.
+*/
+void startsensorbatch(const char *pingid, uint32_t deadline)
+{
+    // Log any batch that is still being collected and complete the meshlog of the last batch
+    // before its entries are replaced
+    flushsensorbatch();
+    LOGSINK.completestream();
+
+    // Reset the batch
+    SENSORBATCH.active = true;
+    strncpy(SENSORBATCH.ping, pingid, IMC_MAXPING);
+    SENSORBATCH.ping[IMC_MAXPING] = '\0';
+    SENSORBATCH.started = millis();
+    SENSORBATCH.deadline = deadline;
+    SENSORBATCH.received = 0;
+    SENSORBATCH.late = 0;
+    SENSORBATCH.count = 0;
+    SENSORBATCH.expected = 0;
+}
+
+// A function that starts a sensor batch that expects a reply from every node currently connected to the mesh.
+void beginsensorbatch(const char *pingid, uint32_t deadline)
+{
+    startsensorbatch(pingid, deadline);
+
+    // Record the nodes currently connected to the mesh as the expected nodes
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (NODEREGISTRY[i].connected) {addsensorbatchentry(NODEREGISTRY[i].node);}
+    }
+    SENSORBATCH.expected = SENSORBATCH.count;
+}
+
+
+/*
+A function that collects a 'sensordata' message into the sensor batch if it replies to the ping of the batch.
+Returns false if the message does not belong to the batch and must be handled on its own.
+*/
+bool collectsensorbatch(MeshFrame &sensordata)
+{
+    // Check that the message replies to the ping of the batch
+    if (!SENSORBATCH.active || strcmp(sensordata.ping, SENSORBATCH.ping) != 0) {return false;}
+
+    // Find the entry of the node, adding one for nodes that joined after the batch started
+    SensorBatchEntry *entry = NULL;
+    for (uint16_t i = 0; i < SENSORBATCH.count; i++) {
+        if (SENSORBATCH.entries[i].node == sensordata.origin) {entry = &SENSORBATCH.entries[i]; break;}
+    }
+    if (entry == NULL) {entry = addsensorbatchentry(sensordata.origin, false);}
+    // Let duplicate replies and replies that do not fit be handled on their own
+    if (entry == NULL || entry->received) {return false;}
+
+    // Store the sensor fields of the reply
+    uint16_t cursor = 0; MeshField field;
+    while (sensordata.nextfield(cursor, field)) {
+        if (field.id == 0 || field.id > SENSORBATCH_KEYS) {continue;}
+        entry->kinds[field.id - 1] = field.kind;
+        entry->values[field.id - 1] = field.uintvalue;
+    }
+    entry->received = true;
+    // Only the replies of expected nodes count towards completing the batch
+    if (entry->expected) {SENSORBATCH.received++;}
+    else {SENSORBATCH.late++;}
+
+    // Log the batch once every expected node has replied
+    if (SENSORBATCH.received >= SENSORBATCH.expected) {flushsensorbatch();}
+    return true;
+}
+
+
+// A function that logs the sensor batch once its deadline has passed.
+void checksensorbatch()
+{
+    if (SENSORBATCH.active && millis() - SENSORBATCH.started >= SENSORBATCH.deadline) {
+        flushsensorbatch();
+    }
+}
+
+
+// Ping Tracker Configuration Values
+#define PINGTRACKER_SIZE NODEREGISTRY_SIZE
+#define PINGTRACKER_TIMEOUT 5000
+#define PINGTRACKER_INTERVAL 500
+#define NODEMETRICS_SIZE 64
+#define RTT_BUCKETS 8
+
+// The upper bounds in milliseconds of the round trip time histogram buckets. The last bucket is unbounded.
+const uint16_t RTTBOUNDS[RTT_BUCKETS - 1] = {25, 50, 100, 200, 400, 800, 1600};
+
+// A structure that holds a command sent by the control node to a node that is waiting for its reply.
+struct PendingPing
+{
+    bool active;
+    uint32_t node;
+    uint32_t sent;
+    char ping[IMC_MAXPING + 1];
+};
+
+// A structure that holds the reply metrics of a single node.
+struct NodeMetrics
+{
+    uint32_t node;
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t timeouts;
+    uint32_t rttmax;
+    uint32_t rttbuckets[RTT_BUCKETS];
+};
+
+// The pending pings and node metrics of the control node, allocated by allocatecontroltables()
+PendingPing *PENDINGPINGS = NULL;
+NodeMetrics *NODEMETRICS = NULL;
+uint8_t NODEMETRICSCOUNT = 0;
+uint32_t PINGSUNTRACKED = 0;
+
+// A function that returns the metrics entry of a node, adding one if needed. Returns NULL if the table is full or not allocated.
+NodeMetrics *getnodemetrics(uint32_t node)
+{
+    for (uint8_t i = 0; i < NODEMETRICSCOUNT; i++) {
+        if (NODEMETRICS[i].node == node) {return &NODEMETRICS[i];}
+    }
+    if (NODEMETRICS == NULL || NODEMETRICSCOUNT >= NODEMETRICS_SIZE) {return NULL;}
+
+    NodeMetrics *metrics = &NODEMETRICS[NODEMETRICSCOUNT++];
+    memset(metrics, 0, sizeof(NodeMetrics));
+    metrics->node = node;
+    return metrics;
+}
+
+// A function that records a ping sent to a single node in the first free slot of the tracker.
+void trackpingnode(const char *pingid, uint32_t node, uint32_t now)
+{
+    if (PENDINGPINGS == NULL) {return;}
+    for (uint16_t i = 0; i < PINGTRACKER_SIZE; i++) {
+        if (PENDINGPINGS[i].active) {continue;}
+        PENDINGPINGS[i].active = true;
+        PENDINGPINGS[i].node = node;
+        PENDINGPINGS[i].sent = now;
+        strncpy(PENDINGPINGS[i].ping, pingid, IMC_MAXPING);
+        PENDINGPINGS[i].ping[IMC_MAXPING] = '\0';
+
+        NodeMetrics *metrics = getnodemetrics(node);
+        if (metrics != NULL) {metrics->requests++;}
+        return;
+    }
+    // Count the pings that could not be tracked because the tracker is full
+    PINGSUNTRACKED++;
+}
+
+/*
+A function that records the send time of a command that expects a reply from the node.
+A broadcast (node 0) is recorded for every node connected to the mesh in the node registry. Only the control node
+tracks pings, as the replies of the sensor nodes are always sent to the control node.
+*/
+void trackpingsend(const char *pingid, uint32_t node)
+{
+    if (MESHCONTROLNODE != mesh.getNodeId()) {return;}
+
+    uint32_t now = millis();
+    if (node != 0) {trackpingnode(pingid, node, now); return;}
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (NODEREGISTRY[i].connected) {trackpingnode(pingid, NODEREGISTRY[i].node, now);}
+    }
+}
+
+/*
+A function that matches a reply to its pending ping and records its round trip time.
+Replies that do not match a pending ping, such as pushed sensordata, are ignored.
+*/
+void trackpingreply(const char *pingid, uint32_t node)
+{
+    if (PENDINGPINGS == NULL) {return;}
+    for (uint16_t i = 0; i < PINGTRACKER_SIZE; i++) {
+        PendingPing &pending = PENDINGPINGS[i];
+        if (!pending.active || pending.node != node || strcmp(pending.ping, pingid) != 0) {continue;}
+        pending.active = false;
+
+        // Record the round trip time into the histogram of the node
+        NodeMetrics *metrics = getnodemetrics(node);
+        if (metrics == NULL) {return;}
+        uint32_t rtt = millis() - pending.sent;
+        uint8_t bucket = 0;
+        while (bucket < RTT_BUCKETS - 1 && rtt >= RTTBOUNDS[bucket]) {bucket++;}
+        metrics->rttbuckets[bucket]++;
+        metrics->replies++;
+        if (rtt > metrics->rttmax) {metrics->rttmax = rtt;}
+        // Record the round trip time in the node registry
+        NodeRecord *record = getnoderecord(node);
+        if (record != NULL) {record->rtt = (rtt > UINT16_MAX) ? UINT16_MAX : rtt;}
+        return;
+    }
+}
+
+/*
+A function that expires the pending pings that have not been replied to within PINGTRACKER_TIMEOUT.
+Called by the trackertask on the meshScheduler every PINGTRACKER_INTERVAL milliseconds.
+*/
+void checkpingtracker()
+{
+    uint32_t now = millis();
+    for (uint16_t i = 0; i < PINGTRACKER_SIZE; i++) {
+        PendingPing &pending = PENDINGPINGS[i];
+        if (!pending.active || now - pending.sent < PINGTRACKER_TIMEOUT) {continue;}
+        pending.active = false;
+
+        NodeMetrics *metrics = getnodemetrics(pending.node);
+        if (metrics != NULL) {metrics->timeouts++;}
+    }
+}
+
+
+/*
+A message handler triggered when a 'sensordata' message is received by the node.
+Collects the message into the sensor batch if it belongs to one, 
+otherwise reads the message and logs a meshlog of type 'sensordata' to the Serial.
+*/
+void handlemessage_sensordata(MeshFrame &sensordata)
+{
+    // Validate the message type to be a 'sensordata'
+    if (sensordata.type == IMC_SENSORDATA) {
+        // Record the round trip time of the ping
+        trackpingreply(sensordata.ping, sensordata.origin);
+        // Refresh the cached config of the node if its config hash changed
+        checkconfighash(sensordata.origin, sensordata.getuint(IMC_FIELD_CONFIGHASH, 0));
+        // Collect the message into the sensor batch if it replies to its ping
+        if (collectsensorbatch(sensordata)) {return;}
+
+        uint32_t nodeID = sensordata.origin;
+
+        // Create the meshlog document
+        JsonDocument &logdoc = beginmeshlog("sensordata", "sensor data received", LOGPRIORITY_HIGH);
+        // Fill in the meshlog values
+        logdoc["logdata"]["node"] = nodeID;
+        logdoc["logdata"]["ping"] = sensordata.ping;
+        fillmeshfields(sensordata, logdoc["logdata"].createNestedObject("sensors"), SENSORKEYS, TABLESIZE(SENSORKEYS));
+        // Log the document to the Serial port.
+        endmeshlog(logdoc);
+    }
+}
+
+// A function that logs the config fields of a 'configdata' message as a meshlog of type 'configdata' to the Serial.
+void logconfigdata(MeshFrame &configdata, bool cached)
+{
+    uint32_t nodeID = configdata.origin;
+
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("configdata", "config data received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = nodeID;
+    logdoc["logdata"]["ping"] = configdata.ping;
+    logdoc["logdata"]["cached"] = cached;
+    // Fill in the config values with the node id first
+    JsonObject config = logdoc["logdata"].createNestedObject("config");
+    config["NODEID"] = nodeID;
+    fillmeshfields(configdata, config, CONFIGKEYS, TABLESIZE(CONFIGKEYS));
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
+
+/*
+A message handler triggered when a 'configdata' message is recieved by the node.
+Stores the config into the config cache and logs a meshlog of type 'configdata' to the Serial.
+Replies to the 'configsync' requests of the config cache only update the cache and are not logged.
+*/
+void handlemessage_configdata(MeshFrame &configdata)
+{
+    // Validate the message type to be a 'configdata'
+    if (configdata.type == IMC_CONFIGDATA) {
+        // Record the round trip time of the ping
+        trackpingreply(configdata.ping, configdata.origin);
+        // Store the config into the config cache
+        storeconfigcache(configdata);
+        if (strcmp(configdata.ping, "configsync") == 0) {return;}
+        // Log the config
+        logconfigdata(configdata, false);
+    }
+}
+
+/*
+A function that answers a 'readconfig' request for a node from the config cache.
+Rebuilds the 'configdata' message from the cached fields and logs it with the cached flag set.
+Returns false if the cached config is missing or does not match the config hash of the node.
+*/
+bool answerconfigfromcache(uint32_t node, const char *pingid)
+{
+    ConfigCacheEntry *entry = findnodeconfig(node);
+    if (entry == NULL) {CONFIGCACHEMISSES++; return false;}
+    entry->lastused = millis();
+
+    // Rebuild the configdata message as if it was sent by the node
+    PooledFrame configdata;
+    if (!configdata.valid()) {return false;}
+    configdata->begin(IMC_CONFIGDATA, IMC_UNICAST, node, mesh.getNodeId(), pingid);
+    configdata->addfields(entry->bytes, entry->length);
+
+    // Log the config
+    CONFIGCACHEHITS++;
+    logconfigdata(*configdata, true);
+    return true;
+}
+
+
+/*
+A message handler triggered when a 'historydata' message is received by the control node.
+Unpacks the history samples of the message into a meshlog of type 'historydata' and logs it to the Serial.
+Every sample is logged as [time, HUM, TEM, GAS, FLM] with null for the values the node does not have.
+*/
+void handlemessage_historydata(MeshFrame &historydata)
+{
+    // Validate the message type to be a 'historydata'
+    if (historydata.type == IMC_HISTORYDATA) {
+        // Create the meshlog document
+        JsonDocument &logdoc = beginmeshlog("historydata", "history data received", LOGPRIORITY_HIGH);
+        // Fill in the meshlog values
+        logdoc["logdata"]["node"] = historydata.origin;
+        logdoc["logdata"]["ping"] = historydata.ping;
+        logdoc["logdata"]["chunk"] = historydata.getuint(IMC_HISTORY_CHUNK, 0);
+        logdoc["logdata"]["last"] = (historydata.getuint(IMC_HISTORY_LAST, 1) != 0);
+        // Log the document to the Serial port and leave it open for the samples
+        if (!openmeshlog(logdoc)) {return;}
+
+        // Stream the samples of the message
+        LOGSINK.print(",\"samples\":[");
+        MeshField field;
+        if (historydata.findfield(IMC_HISTORY_SAMPLES, field) && field.kind == IMC_KIND_BYTES) {
+            for (uint32_t offset = 0; offset + HISTORY_SAMPLESIZE <= field.uintvalue; offset += HISTORY_SAMPLESIZE) {
+                const uint8_t *sample = field.data + offset;
+                uint16_t hum = unpackuint(sample + 4, 2);
+                uint16_t tem = unpackuint(sample + 6, 2);
+                uint16_t gas = unpackuint(sample + 8, 2);
+                uint8_t flm = unpackuint(sample + 10, 1);
+
+                // Fill the sample into a small document and log it to the Serial port
+                StaticJsonDocument<JSON_ARRAY_SIZE(8)> sampledoc;
+                JsonArray values = sampledoc.to<JsonArray>();
+                values.add(unpackuint(sample, 4));
+                if (hum != HISTORY_NOVALUE) {values.add(hum / 10.0);} else {values.add(nullptr);}
+                if (tem != HISTORY_NOTEMPERATURE) {values.add((int16_t)tem / 10.0);} else {values.add(nullptr);}
+                if (gas != HISTORY_NOVALUE) {values.add(gas);} else {values.add(nullptr);}
+                if (flm != HISTORY_NOFLAME) {values.add(flm);} else {values.add(nullptr);}
+
+                if (offset > 0) {LOGSINK.print(",");}
+                serializeJson(sampledoc, LOGSINK);
+            }
+        }
+        LOGSINK.print("]");
+
+        // Complete the meshlog
+        closemeshlog();
+    }
+}
+
+// Mesh Synchronization Configuration Values
+#define SYNC_NODESETTLE 1000
+#define SYNC_CONTROLSETTLE 2000
+
+// The connection changes of the node and of the mesh that have not been reported yet
+uint16_t NODENEWCONNECTIONS = 0;
+uint16_t NODECHANGEDCONNECTIONS = 0;
+uint16_t MESHNEWCONNECTIONS = 0;
+uint16_t MESHCHANGEDCONNECTIONS = 0;
+uint16_t MESHSYNCREPORTS = 0;
+
+// A function that arms a settle window task if it is not already running, so that the window is never extended.
+void armsettlewindow(Task &settletask, uint32_t settle)
+{
+    if (settletask.isEnabled()) {return;}
+    settletask.setInterval(settle);
+    settletask.restartDelayed(settle);
+}
+
+/*
+A function that records a connection change of the mesh on the control node.
+The changes are coalesced over a settle window of SYNC_CONTROLSETTLE milliseconds into a single 'meshsync' meshlog.
+*/
+void recordmeshsync(uint16_t newconnections, uint16_t changedconnections, bool report)
+{
+    MESHNEWCONNECTIONS += newconnections;
+    MESHCHANGEDCONNECTIONS += changedconnections;
+    if (report) {MESHSYNCREPORTS++;}
+    armsettlewindow(meshsynctask, SYNC_CONTROLSETTLE);
+}
+
+/*
+A function that logs the connection changes coalesced over the settle window as a single 'meshsync' meshlog.
+Called by the meshsynctask on the meshScheduler at the end of the settle window. The sync field is 
+'changedconnection' if any connection changed and 'newconnection' otherwise.
+*/
+void flushmeshsync()
+{
+    // Reconcile the node registry with the changed mesh topology
+    reconcilenoderegistry();
+
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("meshsync", "mesh synchronization event");
+    // Fill in the meshlog values
+    logdoc["logdata"]["sync"] = (MESHCHANGEDCONNECTIONS > 0) ? "changedconnection" : "newconnection";
+    logdoc["logdata"]["newconnections"] = MESHNEWCONNECTIONS;
+    logdoc["logdata"]["changedconnections"] = MESHCHANGEDCONNECTIONS;
+    logdoc["logdata"]["reports"] = MESHSYNCREPORTS;
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+
+    // Reset the coalesced changes
+    MESHNEWCONNECTIONS = 0;
+    MESHCHANGEDCONNECTIONS = 0;
+    MESHSYNCREPORTS = 0;
+}
+
+/*
+A message handler triggered when 'connectionupdate' message is recieved by the node.
+Records the change counts of the message into the coalesced 'meshsync' meshlog.
+Messages without change counts count as a single change of their updatetype.
+*/
+void handlemessage_connectionupdate(MeshFrame &connupdate)
+{
+    if (connupdate.type == IMC_CONNECTIONUPDATE) {
+        // Determine the updatetype and the change counts from the connupdate
+        uint8_t updatetype = connupdate.getuint(IMC_FIELD_UPDATETYPE, IMC_UPDATE_NONE);
+        uint16_t newconnections = connupdate.getuint(IMC_FIELD_NEWCOUNT, (updatetype == IMC_UPDATE_NEWCONNECTION) ? 1 : 0);
+        uint16_t changedconnections = connupdate.getuint(IMC_FIELD_CHANGEDCOUNT, (updatetype == IMC_UPDATE_CHANGEDCONNECTION) ? 1 : 0);
+
+        // Record the changes into the coalesced meshsync
+        recordmeshsync(newconnections, changedconnections, true);
+    }
+}
+
+
+/*
+A function that records a connection change of the sensor node.
+The changes are coalesced over a settle window of SYNC_NODESETTLE milliseconds into a single 'connectionupdate' message.
+*/
+void recordconnectionupdate(uint8_t updatetype)
+{
+    if (updatetype == IMC_UPDATE_NEWCONNECTION) {NODENEWCONNECTIONS++;} else {NODECHANGEDCONNECTIONS++;}
+    armsettlewindow(connectionupdatetask, SYNC_NODESETTLE);
+}
+
+
+/*
+A message sender for the 'connectionupdate' message.
+Called by the connectionupdatetask on the meshScheduler at the end of the settle window, and when
+the handshake completes to send the changes that were kept while the control node was unknown.
+
+Sends a message to control node with a field updatetype indicating the type of update to the mesh,
+which is 'changedconnection' if any connection changed and 'newconnection' otherwise, along with 
+the number of each type of change in the settle window.
+*/
+void flushconnectionupdate()
+{
+    // Wait for the MESHCONTROLNODE value to be acquired, keeping the changes until the handshake completes
+    if (MESHCONTROLNODE == 0) {return;}
+    // Skip the message if there are no changes to send
+    if (NODENEWCONNECTIONS == 0 && NODECHANGEDCONNECTIONS == 0) {return;}
+
+    // Create the connectionupdate message unicast to the Control Node
+    PooledFrame connectionupdate;
+    if (!connectionupdate.valid()) {return;}
+    connectionupdate->begin(IMC_CONNECTIONUPDATE, IMC_UNICAST, mesh.getNodeId(), MESHCONTROLNODE, NULL);
+    // Fill in the updatetype and the change counts
+    connectionupdate->addu8(IMC_FIELD_UPDATETYPE, (NODECHANGEDCONNECTIONS > 0) ? IMC_UPDATE_CHANGEDCONNECTION : IMC_UPDATE_NEWCONNECTION);
+    connectionupdate->addu16(IMC_FIELD_NEWCOUNT, NODENEWCONNECTIONS);
+    connectionupdate->addu16(IMC_FIELD_CHANGEDCOUNT, NODECHANGEDCONNECTIONS);
+
+    // Transmit the command
+    sendmeshmessage(*connectionupdate);
+
+    // Reset the coalesced changes
+    NODENEWCONNECTIONS = 0;
+    NODECHANGEDCONNECTIONS = 0;
+}
+
+
+/*
+A function that resolves the pingid arguments of the command senders.
+If the pingid argument is "control" or "remote", a new pingid is generated into the passed buffer 
+and returned, otherwise the pingid argument is returned as is.
+*/
+const char *generatepingid(const char *pingid, char generatedping[IMC_MAXPING + 1])
+{
+    if (strcmp(pingid, "control") == 0) {
+        // Generate a random ping ID for control node pings.
+        snprintf(generatedping, IMC_MAXPING + 1, "controlping%ld", random(100000,999999));
+        return generatedping;
+    } else if (strcmp(pingid, "remote") == 0) {
+        // Generate a randome ping ID for remote node pings.
+        snprintf(generatedping, IMC_MAXPING + 1, "remoteping%ld", random(100000,999999));
+        return generatedping;
+    }
+    return pingid;
+}
+
+
+/*
+A command sender for the 'readsensors' command. 
+
+If node argument passed is 0, the command is sent in broadcast mode i.e to all the nodes. 
+Otherwise, it is sent only to nodeID that is passed in unicast mode.
+
+If the pingid argument is "control", the command will generate a new pingid in the format 'controlping-<random 6 digit number>' and similarly,
+If the pingid argument is "remote", the command will generate a new pingid in the format 'remoteping-<random 6 digit number>'.
+For all other value of pingid, it is used as it for the consequent ping command.
+Returns false if the command could not be sent, such as for a ping ID longer than IMC_MAXPING.
+*/
+bool sendcommand_readsensors(uint32_t node, const char *pingid)
+{
+    // Check if a pingid needs to be generated
+    char generatedping[IMC_MAXPING + 1];
+    pingid = generatepingid(pingid, generatedping);
+
+    // Create the command message. If value of node is 0, set the reach to 'broadcast'
+    // otherwise set it as the destination for a 'unicast' reach
+    PooledFrame requestsensordata;
+    if (!requestsensordata.valid()) {return false;}
+    if (!requestsensordata->begin(IMC_MESHCOMMAND, (node == 0) ? IMC_BROADCAST : IMC_UNICAST, mesh.getNodeId(), node, pingid)) {return false;}
+    // Fill in the command
+    requestsensordata->addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READSENSORS);
+    // Record the ping for the round trip metrics
+    trackpingsend(requestsensordata->ping, node);
+
+    // Transmit the command
+    sendmeshmessage(*requestsensordata);
+    return true;
+} 
+
+
+/*
+A command sender for the 'readconfig' command.
+
+If node argument passed is 0, the command is sent in broadcast mode i.e to all the nodes. 
+Otherwise, it is sent only to nodeID that is passed in unicast mode.
+
+If the pingid argument is "control", the command will generate a new pingid in the format 'controlping-<random 6 digit number>' and similarly,
+If the pingid argument is "remote", the command will generate a new pingid in the format 'remoteping-<random 6 digit number>'.
+For all other value of pingid, it is used as it for the consequent ping command.
+*/
+void sendcommand_readconfig(uint32_t node, const char *pingid)
+{
+    // Check if a pingid needs to be generated
+    char generatedping[IMC_MAXPING + 1];
+    pingid = generatepingid(pingid, generatedping);
+
+    // Create the command message. If value of node is 0, set the reach to 'broadcast'
+    // otherwise set it as the destination for a 'unicast' reach
+    PooledFrame requestconfigdata;
+    if (!requestconfigdata.valid()) {return;}
+    if (!requestconfigdata->begin(IMC_MESHCOMMAND, (node == 0) ? IMC_BROADCAST : IMC_UNICAST, mesh.getNodeId(), node, pingid)) {return;}
+    // Fill in the command
+    requestconfigdata->addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READCONFIG);
+    // Record the ping for the round trip metrics
+    trackpingsend(requestconfigdata->ping, node);
+
+    sendmeshmessage(*requestconfigdata);
+}
+
+
+/*
+A function that generates a meshcommand to request the sensor history of a node from the 'since' node time.
+A node time of 0 requests the whole history.
+*/
+void sendcommand_readhistory(uint32_t node, const char *pingid, uint32_t since)
+{
+    // Create the command message unicast to the node
+    PooledFrame requesthistory;
+    if (!requesthistory.valid()) {return;}
+    requesthistory->begin(IMC_MESHCOMMAND, IMC_UNICAST, mesh.getNodeId(), node, pingid);
+    // Fill in the command and the node time to read the history from
+    requesthistory->addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READHISTORY);
+    requesthistory->addu32(IMC_FIELD_SINCE, since);
+
+    sendmeshmessage(*requesthistory);
+}
+
+
+/*
+A command sender that sends a 'readsensors' or 'readconfig' command to the nodes of a multicast group in a single message.
+The ping is recorded for every node that reported the multicast group in its handshake.
+*/
+void sendcommand_group(uint8_t command, uint32_t group, const char *pingid)
+{
+    // Create the command message multicast to the group
+    PooledFrame requestgroup;
+    if (!requestgroup.valid()) {return;}
+    if (!requestgroup->begin(IMC_MESHCOMMAND, IMC_MULTICAST, mesh.getNodeId(), group, pingid)) {return;}
+    // Fill in the command
+    requestgroup->addu8(IMC_FIELD_COMMAND, command);
+    // Record the ping of every node of the group for the round trip metrics
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (NODEREGISTRY[i].mcastgroup == group) {trackpingsend(requestgroup->ping, NODEREGISTRY[i].node);}
+    }
+
+    sendmeshmessage(*requestgroup);
+}   
+
+
+// Fanout Configuration Values
+#define FANOUT_MAXNODES COMMANDDOC_MAXNODES
+#define FANOUT_INTERVAL 20
+
+// A structure that holds a meshcommand being sent to a list of nodes one at a time by the fanout task.
+struct FanoutJob
+{
+    bool active;
+    uint8_t command;
+    char ping[IMC_MAXPING + 1];
+    uint16_t count;
+    uint16_t position;
+    uint32_t *nodes;
+};
+
+// Global Fanout Job. Its nodes are allocated by allocatecontroltables().
+FanoutJob FANOUT;
+
+
+/*
+A function that sends the meshcommand of the fanout job to its next node. Runs on the fanout task every
+fanout interval until every node has been sent the command, so that a command for many nodes is paced 
+instead of being sent in a single burst. The 'readconfig' command is answered from the config cache if possible.
+*/
+void runfanout()
+{
+    if (!FANOUT.active || FANOUT.position >= FANOUT.count) {
+        FANOUT.active = false;
+        fanouttask.disable();
+        return;
+    }
 
-    // Transmit the sensordata
-    sendmeshmessage(sensordata);
+    // Send the command to the next node of the job
+    uint32_t node = FANOUT.nodes[FANOUT.position++];
+    if (FANOUT.command == IMC_COMMAND_READSENSORS) {
+        sendcommand_readsensors(node, FANOUT.ping);
+    } else if (FANOUT.command == IMC_COMMAND_READCONFIG) {
+        if (!answerconfigfromcache(node, FANOUT.ping)) {sendcommand_readconfig(node, FANOUT.ping);}
+    }
 }
 
 
 /*
-A command handler that responds to the command 'readconfig'.
-The runtime fills in the configuration values from the hardware configuration values,
-wraps it into a 'configdata' message and sends it to the MESHCONTROLNODE.
-*/
-void handlecommand_readconfig(String pingid) 
-{
-    // Create the sensordata document
-    DynamicJsonDocument configdata(1024);
-    configdata["type"] = "message";
-    configdata["origin"] = mesh.getNodeId();
-    // Set the reach parameters to unicast with the Control Node as the destination
-    configdata["reach"]["type"] = "unicast";
-    configdata["reach"]["destination"] = MESHCONTROLNODE;
-    // Fill in the ping ID and set the message type.
-    configdata["data"]["ping"] = pingid;
-    configdata["data"]["type"] = "configdata";
-
-    // Fill in the node id
-    configdata["data"]["config"]["NODEID"] = mesh.getNodeId();
-    // Fill in the sensor configuration values
-    configdata["data"]["config"]["DHTTYP"] = DHTTYP;
-    configdata["data"]["config"]["DHTPIN"] = DHTPIN;
-    configdata["data"]["config"]["GASTYP"] = GASTYP;
-    configdata["data"]["config"]["GASPIN"] = GASPIN;
-    configdata["data"]["config"]["FLMTYP"] = FLMTYP;
-    configdata["data"]["config"]["FLMPIN"] = FLMPIN;
-    // Fill in the other hardware configuration values
-    configdata["data"]["config"]["PINGER"] = PINGER;
-    configdata["data"]["config"]["PINGERPIN"] = PINGERPIN;
-    configdata["data"]["config"]["SERIALBAUD"] = SERIALBAUD;
-    configdata["data"]["config"]["CONNECTLEDPIN"] = CONNECTLEDPIN;
+A function that collects the target nodes of a multi-node control command into the fanout job.
+The targets are either the list of node IDs in 'nodes' or every node of the node registry with the group 
+tag in 'group'. Returns the number of target nodes, of which at most FANOUT_MAXNODES are kept.
+*/
+uint16_t collectfanoutnodes(JsonDocument &controlcommand)
+{
+    FANOUT.count = 0;
+    JsonArray nodes = controlcommand["nodes"];
+    if (!nodes.isNull()) {
+        for (JsonVariant node : nodes) {
+            if (FANOUT.count < FANOUT_MAXNODES) {FANOUT.nodes[FANOUT.count++] = node.as<uint32_t>();}
+        }
+        return FANOUT.count;
+    }
 
-    // Transmit the sensordata
-    sendmeshmessage(configdata);
+    uint8_t group = controlcommand["group"] | 0;
+    if (group == 0) {return 0;}
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (NODEREGISTRY[i].tag == group && FANOUT.count < FANOUT_MAXNODES) {FANOUT.nodes[FANOUT.count++] = NODEREGISTRY[i].node;}
+    }
+    return FANOUT.count;
 }
 
 
 /*
-A control command handler that responds to the control command 'readconfig-control'.
-Accumulates the relevant configuration values for the hardware and mesh into a 
-meshlog of type 'controlconfigdata' and logs it to the Serial.
+A function that starts sending a meshcommand to the target nodes of a multi-node control command.
+The command is sent to one node every 1000 / 'rate' milliseconds (FANOUT_INTERVAL if no rate is passed)
+and every reply carries the batch ID passed as 'ping'. A 'controlbatch' meshlog is logged with the 
+batch ID, the number of target nodes and the pacing interval so that the controller can correlate 
+the replies. A fanout job that is still running is cut short by a new one.
+Returns the pacing interval in milliseconds or 0 if the command had no target nodes.
 */
-void handlecontrolcommand_readconfig() 
+uint32_t beginfanout(JsonDocument &controlcommand, uint8_t command)
 {
+    // Collect the target nodes and resolve the batch ID
+    FANOUT.active = false;
+    if (collectfanoutnodes(controlcommand) == 0) {return 0;}
+    char generatedping[IMC_MAXPING + 1];
+    const char *pingid = generatepingid(controlcommand["ping"] | "", generatedping);
+    strncpy(FANOUT.ping, pingid, IMC_MAXPING);
+    FANOUT.ping[IMC_MAXPING] = '\0';
+
+    // Determine the pacing interval from the rate limit
+    uint32_t rate = controlcommand["rate"] | 0;
+    uint32_t interval = (rate > 0) ? 1000 / rate : FANOUT_INTERVAL;
+    if (interval == 0) {interval = 1;}
+
     // Create the meshlog document
-    StaticJsonDocument<1024> logdoc;
-    logdoc["type"] = "meshlog";
-    logdoc["nodeID"] = mesh.getNodeId();
-    logdoc["nodetime"] = mesh.getNodeTime();
+    JsonDocument &logdoc = beginmeshlog("controlbatch", "control batch started", LOGPRIORITY_HIGH);
     // Fill in the meshlog values
-    logdoc["logdata"]["type"] = "controlconfigdata";
-    logdoc["logdata"]["message"] = "control config data received";
     logdoc["logdata"]["node"] = mesh.getNodeId();
-
-    // Fill in the hardware configuration values
-    logdoc["logdata"]["config"]["PINGER"] = PINGER;
-    logdoc["logdata"]["config"]["PINGERPIN"] = PINGERPIN;
-    logdoc["logdata"]["config"]["SERIALBAUD"] = SERIALBAUD;
-    logdoc["logdata"]["config"]["CONNECTLEDPIN"] = CONNECTLEDPIN;
-    // Fill in the mesh configuration values
-    logdoc["logdata"]["config"]["MESH_SSID"] = MESH_SSID;
-    logdoc["logdata"]["config"]["MESH_PSWD"] = MESH_PSWD;
-    logdoc["logdata"]["config"]["MESH_PORT"] = MESH_PORT;
-    logdoc["logdata"]["config"]["NODEID"] = mesh.getNodeId();
-
+    logdoc["logdata"]["batch"] = FANOUT.ping;
+    logdoc["logdata"]["command"] = COMMANDS[command];
+    logdoc["logdata"]["targets"] = FANOUT.count;
+    logdoc["logdata"]["interval"] = interval;
     // Log the document to the Serial port.
-    serializeJson(logdoc, Serial); Serial.println();
-}
+    endmeshlog(logdoc);
 
-/*
-A control command handler that responds to the control command 'readnodelist'.
-Accumulates the list of nodes connected to the mesh into a 
-meshlog of type 'controlnodelist' and logs it to the Serial.
-*/
-void handlecontrolcommand_nodelist() 
-{
-    // Create an empty string
-    String strnodelist = "";
-    // Retrieve the list of connected nodes from the mesh
-    std::list<uint32_t> nodelist = mesh.getNodeList();
-    // Accumulate the nodelist into a '-' separated string
-    for (uint32_t i : nodelist) {strnodelist = strnodelist + i + "-";}
-
-    // Create the meshlog document. A DynamicJSONDocument is used
-    // to avoid space limitations as the cluster size increases.
-    DynamicJsonDocument logdoc(1024);
-    logdoc["type"] = "meshlog";
-    logdoc["nodeID"] = mesh.getNodeId();
-    logdoc["nodetime"] = mesh.getNodeTime();
-    // Fill in the meshlog valuesre
-    logdoc["logdata"]["type"] = "controlnodelist";
-    logdoc["logdata"]["message"] = "control nodelist data received";
-    logdoc["logdata"]["node"] = mesh.getNodeId();
+    // Start the fanout task with the first node sent right away
+    FANOUT.active = true;
+    FANOUT.command = command;
+    FANOUT.position = 0;
+    fanouttask.setInterval(interval);
+    fanouttask.restart();
+    return interval;
+}
 
-    // Attach the nodelist to the meshlog
-    logdoc["logdata"]["nodelist"] = strnodelist;
 
-    // Log the document to the Serial port.
-    serializeJson(logdoc, Serial); Serial.println();
+// A control command handler that responds to the control command 'connection-on'.
+void handlecontrolcommand_connectionon(JsonDocument &controlcommand)
+{
+    MESHCONNECTED = true;
 }
 
+// A control command handler that responds to the control command 'connection-off'.
+void handlecontrolcommand_connectionoff(JsonDocument &controlcommand)
+{
+    MESHCONNECTED = false;
+}
 
 /*
-A message handler triggered when a 'meshcommand' message is received by the node. 
-Calls the appropriate 'handlecommand_' runtime to execute the command instruction. 
+A control command handler that responds to the control command 'readsensors-mesh'.
+Sends the 'readsensors' command in broadcast mode and begins a sensor batch that collects the replies
+if the command was sent, so that a rejected ping ID does not leave an empty batch behind.
 */
-void handlemessage_meshcommand(DynamicJsonDocument commandmessage) 
+void handlecontrolcommand_readsensorsmesh(JsonDocument &controlcommand)
 {
-    // Validate the message type to be a 'meshcommand'
-    if (commandmessage["data"]["type"] == "meshcommand") {
-        // Determine the command.
-        String command = commandmessage["data"]["command"];
-
-        // Create the meshlog document
-        StaticJsonDocument<512> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "meshcommandreceived";
-        logdoc["logdata"]["message"] = "command received from the mesh";
-        logdoc["logdata"]["command"] = command;
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
+    // Detect the ping ID and resolve it once so that the batch and the replies share it
+    char generatedping[IMC_MAXPING + 1];
+    const char *pingid = generatepingid(controlcommand["ping"] | "", generatedping);
+    uint32_t deadline = controlcommand["deadline"] | SENSORBATCH_DEADLINE;
+    // Send the 'readsensor' command in broadcast mode
+    if (!sendcommand_readsensors(0, pingid)) {return;}
+    // Collect the replies into a single sensor batch
+    beginsensorbatch(pingid, deadline);
+}
 
-        // Call the appropriate command handler runtime.
-        if (command == "readsensors") {
-            String pingid = commandmessage["data"]["ping"];
-            handlecommand_readsensors(pingid);
-        }
-        else if (command == "readconfig") {
-            String pingid = commandmessage["data"]["ping"];
-            handlecommand_readconfig(pingid);
-        }
-    }
+// A control command handler that responds to the control command 'readsensors-node'.
+void handlecontrolcommand_readsensorsnode(JsonDocument &controlcommand)
+{
+    // Detect the destination node and ping ID
+    uint32_t node = controlcommand["node"].as<uint32_t>();
+    const char *pingid = controlcommand["ping"] | "";
+    // Send the 'readsensor' command in unicast mode
+    sendcommand_readsensors(node, pingid);
 }
 
+// A structure that holds a 'readconfig-mesh' command being answered for the node registry one node at a time.
+struct ConfigReply
+{
+    bool active;
+    char ping[IMC_MAXPING + 1];
+    uint16_t position;
+};
+
+// Global Config Reply Job
+ConfigReply CONFIGREPLY;
+
 
 /*
-A message handler triggered when a 'handshake' message is received by the node. 
-Sends a 'handshakeACK' message back to the node that sent the 'handshake' message and sends a 
-'readconfig' command to the same node and finally logs the 'handshakerequested' meshlog to the Serial port
+A function that answers the 'readconfig-mesh' command for the next connected node of the node registry.
+Runs on the config reply task every CONFIGCACHE_REPLYINTERVAL until the registry has been walked and waits
+while the high priority lane of the log sink has less than CONFIGCACHE_LOGSPACE bytes free, so that the 
+cached configs of a large mesh are logged at the pace the Serial port drains them instead of stalling it.
+A node that misses the cache is sent the 'readconfig' command instead.
 */
-void handlemessage_handshake(DynamicJsonDocument handshakemessage) 
+void runconfigreply()
 {
-    // Validate the message type to be a 'handshake'
-    if (handshakemessage["data"]["type"] == "handshake") {
-        // Determine the nodeID requesting a handshake
-        uint32_t friendlynode = handshakemessage["origin"].as<uint32_t>();
-
-        // Create the handshakeACK document
-        DynamicJsonDocument handshakeACK(512);
-        handshakeACK["type"] = "message";
-        handshakeACK["origin"] = mesh.getNodeId();
-        // Fill in the reach parameters
-        handshakeACK["reach"]["type"] = "unicast";
-        handshakeACK["reach"]["destination"] = friendlynode;
-        // Fill in the handshakeACK values
-        handshakeACK["data"]["type"] = "handshakeACK";
-        handshakeACK["data"]["controlnode"] = mesh.getNodeId();
-        handshakeACK["data"]["message"] = "handshake acknowledged";
+    // Skip to the next connected node of the registry
+    while (CONFIGREPLY.active && CONFIGREPLY.position < NODEREGISTRYCOUNT && !NODEREGISTRY[CONFIGREPLY.position].connected) {
+        CONFIGREPLY.position++;
+    }
+    if (!CONFIGREPLY.active || CONFIGREPLY.position >= NODEREGISTRYCOUNT) {
+        CONFIGREPLY.active = false;
+        configreplytask.disable();
+        return;
+    }
+    if (LOGSINK.available(LOGPRIORITY_HIGH) < CONFIGCACHE_LOGSPACE) {return;}
 
-        // Transmit the handshakeACK
-        sendmeshmessage(handshakeACK);
+    // Answer the node from the cache or with a 'readconfig' command
+    uint32_t node = NODEREGISTRY[CONFIGREPLY.position++].node;
+    if (!answerconfigfromcache(node, CONFIGREPLY.ping)) {sendcommand_readconfig(node, CONFIGREPLY.ping);}
+}
 
-        //TODO: configdata request code would come here.
+/*
+A control command handler that responds to the control command 'readconfig-mesh'.
+Answers the connected nodes with a cached config from the config cache and sends the 'readconfig' 
+command in unicast mode only to the nodes that miss it, one node every CONFIGCACHE_REPLYINTERVAL. If more 
+than CONFIGCACHE_MAXMISSES nodes miss the cache, or no connected node is known, the command is sent once 
+in broadcast mode instead. A new command replaces an answer that is still running.
+*/
+void handlecontrolcommand_readconfigmesh(JsonDocument &controlcommand)
+{
+    // Detect the ping ID and resolve it once so that all the replies share it
+    char generatedping[IMC_MAXPING + 1];
+    const char *pingid = generatepingid(controlcommand["ping"] | "", generatedping);
+    CONFIGREPLY.active = false;
 
-        // Create the meshlog document
-        StaticJsonDocument<512> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "handshake-rxack";
-        logdoc["logdata"]["message"] = "handshake requested and acknowledged for a node on the mesh";
-        logdoc["logdata"]["node"] = friendlynode;
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
+    // Count the connected nodes that miss the cache
+    uint16_t cached = 0; uint16_t misses = 0;
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (!NODEREGISTRY[i].connected) {continue;}
+        if (isconfigcached(NODEREGISTRY[i].node)) {cached++;} else {misses++;}
+    }
+    // Send the 'readconfig' command in broadcast mode if too many nodes miss the cache
+    if (misses > CONFIGCACHE_MAXMISSES || cached + misses == 0) {
+        sendcommand_readconfig(0, pingid);
+        return;
     }
+
+    // Answer every connected node from the cache or with a 'readconfig' command on the config reply task
+    strncpy(CONFIGREPLY.ping, pingid, IMC_MAXPING);
+    CONFIGREPLY.ping[IMC_MAXPING] = '\0';
+    CONFIGREPLY.position = 0;
+    CONFIGREPLY.active = true;
+    configreplytask.restart();
+}
+
+// A control command handler that responds to the control command 'readconfig-node'. Answers from the config cache if possible.
+void handlecontrolcommand_readconfignode(JsonDocument &controlcommand)
+{
+    // Detect the destination node and ping ID
+    uint32_t node = controlcommand["node"].as<uint32_t>();
+    char generatedping[IMC_MAXPING + 1];
+    const char *pingid = generatepingid(controlcommand["ping"] | "", generatedping);
+    // Answer from the cache or send the 'readconfig' command
+    if (!answerconfigfromcache(node, pingid)) {sendcommand_readconfig(node, pingid);}
 }
 
 
 /*
-A message handler triggered when a 'handshakeACK' message is received by the node. 
-Sets the MESHCONTROLNODE global, logs a 'handshakecomplete' meshlog to the Serial.
+A control command handler that responds to the control command 'readsensors-nodes'.
+Sends the 'readsensors' command to a list of nodes or a group of nodes with pacing and collects the 
+replies into a single sensor batch, whose deadline is extended by the time it takes to send the commands.
 */
-void handlemessage_handshakeACK(DynamicJsonDocument handshakemessage) 
+void handlecontrolcommand_readsensorsnodes(JsonDocument &controlcommand)
 {
-    // Validate the message type to be a 'handshakeACK'
-    if (handshakemessage["data"]["type"] == "handshakeACK") {
-        // Determine the ControlNodeID from the acknowledgement
-        MESHCONTROLNODE = handshakemessage["data"]["controlnode"].as<uint32_t>();
+    // Start the fanout job
+    uint32_t interval = beginfanout(controlcommand, IMC_COMMAND_READSENSORS);
+    if (interval == 0) {return;}
 
-        // Create the meshlog document
-        StaticJsonDocument<512> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "handshakecomplete";
-        logdoc["logdata"]["message"] = "handshake completed with control node";
-        logdoc["logdata"]["controlnode"] = MESHCONTROLNODE;
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
-    }    
+    // Collect the replies of the target nodes into a single sensor batch
+    uint32_t deadline = controlcommand["deadline"] | SENSORBATCH_DEADLINE;
+    startsensorbatch(FANOUT.ping, deadline + interval * (FANOUT.count - 1));
+    for (uint16_t i = 0; i < FANOUT.count; i++) {addsensorbatchentry(FANOUT.nodes[i]);}
+    SENSORBATCH.expected = SENSORBATCH.count;
 }
 
+// A control command handler that responds to the control command 'readconfig-nodes'. Sends the 'readconfig' command to a list or group of nodes with pacing.
+void handlecontrolcommand_readconfignodes(JsonDocument &controlcommand)
+{
+    beginfanout(controlcommand, IMC_COMMAND_READCONFIG);
+}
 
 /*
-A message handler triggered when a 'sensordata' message is received by the node.
-Reads the message and logs a meshlog of type 'sensordata' to the Serial.
+A control command handler that responds to the control command 'readsensors-group'.
+Sends the 'readsensors' command to the multicast 'group' in a single message and collects the 
+replies of the nodes that reported the multicast group in their handshake into a single sensor batch.
 */
-void handlemessage_sensordata(DynamicJsonDocument sensordata)
+void handlecontrolcommand_readsensorsgroup(JsonDocument &controlcommand)
 {
-    // Validate the message type to be a 'sensordata'
-    if (sensordata["data"]["type"] == "sensordata") {
-        uint32_t nodeID = sensordata["origin"].as<uint32_t>();
-        String pingid = sensordata["data"]["ping"];
+    // Detect the group, ping ID and the batch deadline
+    uint32_t group = controlcommand["group"].as<uint32_t>();
+    if (group == 0) {return;}
+    char generatedping[IMC_MAXPING + 1];
+    const char *pingid = generatepingid(controlcommand["ping"] | "", generatedping);
+    uint32_t deadline = controlcommand["deadline"] | SENSORBATCH_DEADLINE;
 
-        // Create the meshlog document
-        StaticJsonDocument<1024> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "sensordata";
-        logdoc["logdata"]["message"] = "sensor data received";
-        logdoc["logdata"]["node"] = nodeID;
-        logdoc["logdata"]["ping"] = pingid;
-        logdoc["logdata"]["sensors"] = sensordata["data"]["sensors"];
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
+    // Collect the replies of the nodes of the group into a single sensor batch
+    startsensorbatch(pingid, deadline);
+    for (uint16_t i = 0; i < NODEREGISTRYCOUNT; i++) {
+        if (NODEREGISTRY[i].mcastgroup == group) {addsensorbatchentry(NODEREGISTRY[i].node);}
     }
+    SENSORBATCH.expected = SENSORBATCH.count;
+    // Send the 'readsensors' command in multicast mode
+    sendcommand_group(IMC_COMMAND_READSENSORS, group, pingid);
 }
 
-/*
-A message handler triggered when a 'configdata' message is recieved by the node.
-Reads the message and logs a meshlog of type 'configdata' to the Serial.
-*/
-void handlemessage_configdata(DynamicJsonDocument configdata)
+// A control command handler that responds to the control command 'readconfig-group'. Sends the 'readconfig' command to the multicast 'group' in a single message.
+void handlecontrolcommand_readconfiggroup(JsonDocument &controlcommand)
 {
-    // Validate the message type to be a 'configdata'
-    if (configdata["data"]["type"] == "configdata") {
-        uint32_t nodeID = configdata["origin"].as<uint32_t>();
-        String pingid = configdata["data"]["ping"];
-
-        // Create the meshlog document
-        StaticJsonDocument<1024> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "configdata";
-        logdoc["logdata"]["message"] = "config data received";
-        logdoc["logdata"]["node"] = nodeID;
-        logdoc["logdata"]["ping"] = pingid;
-        logdoc["logdata"]["config"] = configdata["data"]["config"];
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
-    }
+    // Detect the group and ping ID
+    uint32_t group = controlcommand["group"].as<uint32_t>();
+    if (group == 0) {return;}
+    char generatedping[IMC_MAXPING + 1];
+    const char *pingid = generatepingid(controlcommand["ping"] | "", generatedping);
+    // Send the 'readconfig' command in multicast mode
+    sendcommand_group(IMC_COMMAND_READCONFIG, group, pingid);
 }
 
 /*
-A message handler triggered when 'connectionupdate' message is recieved by the node.
-Reads the message and logs a meshlog of type 'meshsync' with appropriate sync field set to the Serial.
+A control command handler that responds to the control command 'setgroup-control'.
+Sets the group tag of the nodes in 'nodes' to 'group' in the node registry, with 0 clearing it.
+The group tag selects the target nodes of the multi-node control commands. It is kept apart from
+the multicast group the node reports in its handshake, which the handshake does not change.
 */
-void handlemessage_connectionupdate(DynamicJsonDocument connupdate)
+void handlecontrolcommand_setgroup(JsonDocument &controlcommand)
 {
-    if (connupdate["data"]["type"] == "connectionupdate") {
-        // Determine the updatetype string from the connupdate
-        String updatetype = connupdate["data"]["updatetype"];
-
-        // Create the meshlog document
-        StaticJsonDocument<512> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "meshsync";
-        logdoc["logdata"]["sync"] = updatetype;
-        logdoc["logdata"]["message"] = "mesh synchronization event";
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();    
+    uint8_t group = controlcommand["group"] | 0;
+    JsonArray nodes = controlcommand["nodes"];
+    for (JsonVariant node : nodes) {
+        NodeRecord *record = getnoderecord(node.as<uint32_t>());
+        if (record != NULL) {record->tag = group;}
     }
 }
 
-/*
-A message sender for the 'connectionupdate' message.
 
-Sends a message to control node with a field updatetype 
-indicating the type of update to the mesh.
-*/
-void sendmessage_connectionupdate(String updatetype) 
-{   
-    // Create command document
-    DynamicJsonDocument connectionupdate(512); 
-    connectionupdate["type"] = "message";
-    connectionupdate["origin"] = mesh.getNodeId();
-    // Fill in the reach parameters
-    connectionupdate["reach"]["type"] = "unicast";
-    connectionupdate["reach"]["destination"] = MESHCONTROLNODE;
-    // Fill in the message type and updatetype
-    connectionupdate["data"]["type"] = "connectionupdate";
-    connectionupdate["data"]["updatetype"] = updatetype;
+// A control command handler that responds to the control command 'readhistory-node'.
+void handlecontrolcommand_readhistorynode(JsonDocument &controlcommand)
+{
+    // Detect the destination node, ping ID and the node time to read from
+    uint32_t node = controlcommand["node"].as<uint32_t>();
+    const char *pingid = controlcommand["ping"] | "";
+    uint32_t since = controlcommand["since"] | 0;
+    // Send the 'readhistory' command
+    sendcommand_readhistory(node, pingid, since);
+}
 
-    // Transmit the command
-    sendmeshmessage(connectionupdate);
+
+// A function that computes the 32-bit FNV-1a hash of a command name. Evaluated at compile time for the command table.
+constexpr uint32_t hashcommand(const char *name, uint32_t hash = 2166136261u)
+{
+    return (*name == 0) ? hash : hashcommand(name + 1, (hash ^ (uint8_t)*name) * 16777619u);
 }
 
+// A function pointer type for the 'handlecontrolcommand_' runtimes.
+typedef void (*controlcommandhandler)(JsonDocument &controlcommand);
+
+// A structure that maps a control command name to its handler.
+struct ControlCommandEntry
+{
+    uint32_t hash;
+    const char *name;
+    controlcommandhandler handler;
+};
+
+void handlecontrolcommand_stats(JsonDocument &controlcommand);
+void handlecontrolcommand_metrics(JsonDocument &controlcommand);
+
+// A macro that builds a control command table entry with its name hashed at compile time.
+#define CONTROLCOMMAND(name, handler) {hashcommand(name), name, handler}
 
 /*
-A command sender for the 'readsensors' command. 
+The control command table. New control commands are registered by adding an entry here.
+The command received from the controller is hashed once and matched against the 
+precomputed hashes, with the name compared only to confirm a hash match.
+*/
+const ControlCommandEntry CONTROLCOMMANDS[] = {
+    CONTROLCOMMAND("connection-on", handlecontrolcommand_connectionon),
+    CONTROLCOMMAND("connection-off", handlecontrolcommand_connectionoff),
+    CONTROLCOMMAND("readsensors-mesh", handlecontrolcommand_readsensorsmesh),
+    CONTROLCOMMAND("readsensors-node", handlecontrolcommand_readsensorsnode),
+    CONTROLCOMMAND("readconfig-mesh", handlecontrolcommand_readconfigmesh),
+    CONTROLCOMMAND("readconfig-node", handlecontrolcommand_readconfignode),
+    CONTROLCOMMAND("readhistory-node", handlecontrolcommand_readhistorynode),
+    CONTROLCOMMAND("readsensors-nodes", handlecontrolcommand_readsensorsnodes),
+    CONTROLCOMMAND("readconfig-nodes", handlecontrolcommand_readconfignodes),
+    CONTROLCOMMAND("readsensors-group", handlecontrolcommand_readsensorsgroup),
+    CONTROLCOMMAND("readconfig-group", handlecontrolcommand_readconfiggroup),
+    CONTROLCOMMAND("setgroup-control", handlecontrolcommand_setgroup),
+    CONTROLCOMMAND("readconfig-control", handlecontrolcommand_readconfig),
+    CONTROLCOMMAND("readnodelist-control", handlecontrolcommand_nodelist),
+    CONTROLCOMMAND("readmemory-control", handlecontrolcommand_memory),
+    CONTROLCOMMAND("readstats-control", handlecontrolcommand_stats),
+    CONTROLCOMMAND("readmetrics-control", handlecontrolcommand_metrics),
+    CONTROLCOMMAND("readprofile-node", handlecontrolcommand_readprofilenode),
+    CONTROLCOMMAND("readprofile-control", handlecontrolcommand_readprofile),
+    CONTROLCOMMAND("readtraffic-node", handlecontrolcommand_readtrafficnode),
+    CONTROLCOMMAND("readtraffic-control", handlecontrolcommand_readtraffic)
+};
 
-If node argument passed is 0, the command is sent in broadcast mode i.e to all the nodes. 
-Otherwise, it is sent only to nodeID that is passed in unicast mode.
+// Handling and parsing time statistics for every control command, indexed by its position in the control command table.
+DispatchStats CONTROLSTATS[TABLESIZE(CONTROLCOMMANDS)];
+DispatchStats CONTROLPARSESTATS[TABLESIZE(CONTROLCOMMANDS)];
 
-If the pingid argument is "control", the command will generate a new pingid in the format 'controlping-<random 6 digit number>' and similarly,
-If the pingid argument is "remote", the command will generate a new pingid in the format 'remoteping-<random 6 digit number>'.
-For all other value of pingid, it is used as it for the consequent ping command.
+// Controller Line Configuration Values. A line holds a command with a 'nodes' list of FANOUT_MAXNODES node IDs.
+#define CONTROLLINE_SIZE 1024
+#define CONTROLLINE_MAXBYTES 512
+#define CONTROLLINE_MAXLINES 8
+
+// The line buffer of the controller messages, which accumulates the bytes of a line across update() calls.
+char CONTROLLINE[CONTROLLINE_SIZE];
+uint16_t CONTROLLINELENGTH = 0;
+bool CONTROLLINEOVERFLOW = false;
+// Counters of the controller lines that were received, could not be parsed or did not fit the line buffer.
+uint32_t CONTROLLINES = 0;
+uint32_t CONTROLMALFORMED = 0;
+uint32_t CONTROLOVERLONG = 0;
+
+
+/*
+A control command handler that responds to the control command 'readstats-control'.
+Accumulates the handling time statistics of every message type and control command that 
+has been handled at least once, the parsing time statistics of the control commands and the
+counters of the controller lines into a meshlog of type 'controlstatsdata' and logs it to the Serial.
 */
-void sendcommand_readsensors(uint32_t node, String pingid) 
+void handlecontrolcommand_stats(JsonDocument &controlcommand)
 {
-    // Create command document
-    DynamicJsonDocument requestsensordata(512); 
-    requestsensordata["type"] = "message";
-    requestsensordata["origin"] = mesh.getNodeId();
-    // Fill in the reach parameters
-    if (node == 0) {
-        // If value of node is 0, set the reach to 'broadcast'
-        requestsensordata["reach"]["type"] = "broadcast";
-    } else {
-        // If value of node is passed, set it as the destination for a 'unicast' reach
-        requestsensordata["reach"]["type"] = "unicast";
-        requestsensordata["reach"]["destination"] = node;
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("controlstatsdata", "control stats data received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = mesh.getNodeId();
+
+    // Fill in the statistics of the handled message types
+    JsonObject messages = logdoc["logdata"].createNestedObject("messages");
+    for (uint8_t index = 0; index < TABLESIZE(MESSAGESTATS); index++) {
+        if (MESSAGESTATS[index].count > 0) {filldispatchstats(messages, MESSAGETYPES[index], MESSAGESTATS[index]);}
     }
-    // Fill in the command values and metadata
-    requestsensordata["data"]["type"] = "meshcommand";
-    requestsensordata["data"]["command"] = "readsensors";
-    requestsensordata["data"]["message"] = "sensor data requested";
-    requestsensordata["data"]["ping"] = pingid;
+    // Fill in the statistics of the handled control commands
+    JsonObject commands = logdoc["logdata"].createNestedObject("commands");
+    for (uint8_t index = 0; index < TABLESIZE(CONTROLSTATS); index++) {
+        if (CONTROLSTATS[index].count > 0) {filldispatchstats(commands, CONTROLCOMMANDS[index].name, CONTROLSTATS[index]);}
+    }
+    // Fill in the parsing statistics of the control commands and the controller line counters
+    JsonObject parsing = logdoc["logdata"].createNestedObject("parsing");
+    for (uint8_t index = 0; index < TABLESIZE(CONTROLPARSESTATS); index++) {
+        if (CONTROLPARSESTATS[index].count > 0) {filldispatchstats(parsing, CONTROLCOMMANDS[index].name, CONTROLPARSESTATS[index]);}
+    }
+    logdoc["logdata"]["lines"]["received"] = CONTROLLINES;
+    logdoc["logdata"]["lines"]["malformed"] = CONTROLMALFORMED;
+    logdoc["logdata"]["lines"]["overlong"] = CONTROLOVERLONG;
 
-    // Transmit the command
-    sendmeshmessage(requestsensordata);
-} 
+    // Log the document to the Serial port.
+    endmeshlog(logdoc);
+}
 
 
 /*
-A command sender for the 'readconfig' command.
-
-If node argument passed is 0, the command is sent in broadcast mode i.e to all the nodes. 
-Otherwise, it is sent only to nodeID that is passed in unicast mode.
-
-If the pingid argument is "control", the command will generate a new pingid in the format 'controlping-<random 6 digit number>' and similarly,
-If the pingid argument is "remote", the command will generate a new pingid in the format 'remoteping-<random 6 digit number>'.
-For all other value of pingid, it is used as it for the consequent ping command.
+A control command handler that responds to the control command 'readmetrics-control'.
+Accumulates the ping round trip metrics of every node into a meshlog of type 'controlmetricsdata'
+and streams it to the Serial. Each node reports its requests, replies, reply rate, timeouts, 
+maximum round trip time and round trip time histogram, whose bucket bounds are listed in 'rttbounds'.
 */
-void sendcommand_readconfig(uint32_t node, String pingid)
+void handlecontrolcommand_metrics(JsonDocument &controlcommand)
 {
-    // Check if a pingid needs to be generated
-    if (pingid == "control") {
-        // Generate a random ping ID for control node pings.
-        pingid = "controlping" + String(random(100000,999999));
-    } else if (pingid == "remote") {
-        // Generate a randome ping ID for remote node pings.
-        pingid = "remoteping" + String(random(100000,999999));
+    // Count the pings that are still waiting for a reply
+    uint16_t pending = 0;
+    for (uint16_t i = 0; i < PINGTRACKER_SIZE; i++) {
+        if (PENDINGPINGS[i].active) {pending++;}
     }
 
-    DynamicJsonDocument requestconfigdata(512); 
-    requestconfigdata["type"] = "message";
-    requestconfigdata["origin"] = mesh.getNodeId();
+    // Create the meshlog document
+    JsonDocument &logdoc = beginmeshlog("controlmetricsdata", "control metrics data received", LOGPRIORITY_HIGH);
+    // Fill in the meshlog values
+    logdoc["logdata"]["node"] = mesh.getNodeId();
+    logdoc["logdata"]["pending"] = pending;
+    logdoc["logdata"]["untracked"] = PINGSUNTRACKED;
+    logdoc["logdata"]["reliable"]["retries"] = RELIABLERETRIES;
+    logdoc["logdata"]["reliable"]["giveups"] = RELIABLEGIVEUPS;
+    logdoc["logdata"]["reliable"]["duplicates"] = RELIABLEDUPLICATES;
+    logdoc["logdata"]["reliable"]["untracked"] = RELIABLEUNTRACKED;
+    logdoc["logdata"]["configcache"]["cached"] = CONFIGCACHECOUNT;
+    logdoc["logdata"]["configcache"]["hits"] = CONFIGCACHEHITS;
+    logdoc["logdata"]["configcache"]["misses"] = CONFIGCACHEMISSES;
+    logdoc["logdata"]["configcache"]["evictions"] = CONFIGCACHEEVICTIONS;
+    JsonArray bounds = logdoc["logdata"].createNestedArray("rttbounds");
+    for (uint8_t i = 0; i < RTT_BUCKETS - 1; i++) {bounds.add(RTTBOUNDS[i]);}
+    // Log the document to the Serial port and leave it open for the node metrics
+    if (!openmeshlog(logdoc)) {return;}
+
+    // Stream the metrics of every node
+    LOGSINK.print(",\"nodes\":[");
+    for (uint8_t i = 0; i < NODEMETRICSCOUNT; i++) {
+        NodeMetrics &metrics = NODEMETRICS[i];
 
-    if (node == 0) {
-        // If value of node is 0, set the reach to 'broadcast'
-        requestconfigdata["reach"]["type"] = "broadcast";
-    } else {
-        // If value of node is passed, set it as the destination for a 'unicast' reach
-        requestconfigdata["reach"]["type"] = "unicast";
-        requestconfigdata["reach"]["destination"] = node;
+        // Fill the metrics into a small document and log it to the Serial port
+        StaticJsonDocument<JSON_OBJECT_SIZE(24)> metricsdoc;
+        metricsdoc["node"] = metrics.node;
+        metricsdoc["requests"] = metrics.requests;
+        metricsdoc["replies"] = metrics.replies;
+        metricsdoc["rate"] = (metrics.requests > 0) ? (float)metrics.replies / metrics.requests : 0;
+        metricsdoc["timeouts"] = metrics.timeouts;
+        metricsdoc["rttmax"] = metrics.rttmax;
+        JsonArray buckets = metricsdoc.createNestedArray("rtt");
+        for (uint8_t bucket = 0; bucket < RTT_BUCKETS; bucket++) {buckets.add(metrics.rttbuckets[bucket]);}
+
+        if (i > 0) {LOGSINK.print(",");}
+        serializeJson(metricsdoc, LOGSINK);
     }
+    LOGSINK.print("]");
 
-    // Fill in the command values and metadata
-    requestconfigdata["data"]["type"] = "meshcommand";
-    requestconfigdata["data"]["command"] = "readconfig";
-    requestconfigdata["data"]["message"] = "config data requested";
-    requestconfigdata["data"]["ping"] = pingid;
+    // Complete the meshlog
+    closemeshlog();
+}
 
-    sendmeshmessage(requestconfigdata);
-}   
 
+/*
+A function that finds a command in the control command table. The command is hashed once and its name is
+only compared for an entry with a matching hash. Returns the index of the entry or -1 if it is not found.
+*/
+int8_t findcontrolcommand(const char *command)
+{
+    uint32_t hash = hashcommand(command);
+    for (uint8_t index = 0; index < TABLESIZE(CONTROLCOMMANDS); index++) {
+        if (CONTROLCOMMANDS[index].hash == hash && strcmp(CONTROLCOMMANDS[index].name, command) == 0) {return index;}
+    }
+    return -1;
+}
 
 /*
 A function that handles commands received from the controller on the Serial port. 
-Checks the command and calls the appropriate 'sendcommand_' method
+Looks up the command in the control command table and calls the matching 'handlecontrolcommand_' runtime.
 */
-void handlecontrolcommand(DynamicJsonDocument controlcommand)
+void handlecontrolcommand(JsonDocument &controlcommand, uint32_t parsemicros)
 {
-    // Determine the command from the controlmessage
-    String command = controlcommand["command"];
+    // Determine the command from the controlmessage and find it in the control command table
+    const char *command = controlcommand["command"] | "";
+    int8_t index = findcontrolcommand(command);
 
-    // Check the command and call the appropriate runtime.
-    if (command == "connection-on") {
-        MESHCONNECTED = true;
-    }
-    else if (command == "connection-off") {
-        MESHCONNECTED = false;
-    }
-    else if (command == "readsensors-mesh") {
-        // Detect the ping ID
-        String pingid = controlcommand["ping"].as<String>();
-        // Send the 'readsensor' command in broadcast mode
-        sendcommand_readsensors(0, pingid);
-    }
-    else if (command == "readsensors-node") {
-        // Detect the destination node and ping ID
-        uint32_t node = controlcommand["node"].as<uint32_t>();
-        String pingid = controlcommand["ping"].as<String>();
-        // Send the 'readsensor' command in unicast mode
-        sendcommand_readsensors(node, pingid);
-    }
-    else if (command == "readconfig-mesh") {
-        // Detect the ping ID
-        String pingid = controlcommand["ping"].as<String>();
-        // Send the 'readconfig' command
-        sendcommand_readconfig(0, pingid);
-    }
-    else if (command == "readconfig-node") {
-        // Detect the destination node and ping ID
-        uint32_t node = controlcommand["node"].as<uint32_t>();
-        String pingid = controlcommand["ping"].as<String>();
-        // Send the 'readconfig' command
-        sendcommand_readconfig(node, pingid);
-    }
-    else if (command == "readconfig-control") {
-        handlecontrolcommand_readconfig();
-    }
-    else if (command == "readnodelist-control") {
-        handlecontrolcommand_nodelist();
+    // Call the runtime of the command
+    if (index >= 0) {
+        recordelapsed(CONTROLPARSESTATS[index], parsemicros);
+        uint32_t started = micros();
+        CONTROLCOMMANDS[index].handler(controlcommand);
+        recorddispatch(CONTROLSTATS[index], started);
     }
+
+    // Record the heap low water mark after handling the command
+    trackheap();
 }
 
 
 /* 
 A Mesh callback function triggered when there is a new connections to the node. 
 This callback is exclusively used by FyrNode objects.  
-The callback sends a 'connectionupdate' message with updatetype 'newconnection' to mesh control node which handles the mesh synchronization.
+The callback records a 'newconnection' change, which is reported in a coalesced 'connectionupdate' message to mesh control node which handles the mesh synchronization.
 Refer to the API documentation for more information about the 'meshlog' structure.
 */
 void meshcallback_newconnection(uint32_t nodeID) 
 {   
-    sendmessage_connectionupdate("newconnection");
+    recordconnectionupdate(IMC_UPDATE_NEWCONNECTION);
 }
 
 
 /* 
 A Mesh callback function triggered when there is a new connections to the node. 
 This callback is exclusively used by FyrNodeControl objects. 
-The callback generates a 'meshlog' document of type 'meshsync' with the sync set to 'newconnection' and logs it to the Serial.
+The callback records a 'newconnection' change into the coalesced 'meshsync' meshlog.
 Refer to the API documentation for more information about the 'meshlog' structure.
 */
 void meshcallback_controlnode_newconnection(uint32_t nodeID)
 {
-    // Create the meshlog document
-    StaticJsonDocument<512> logdoc;
-    logdoc["type"] = "meshlog";
-    logdoc["nodeID"] = mesh.getNodeId();
-    logdoc["nodetime"] = mesh.getNodeTime();
-    // Fill in the meshlog values
-    logdoc["logdata"]["type"] = "meshsync";
-    logdoc["logdata"]["sync"] = "newconnection";
-    logdoc["logdata"]["message"] = "new node added on mesh";
-    // Log the document to the Serial port.
-    serializeJson(logdoc, Serial); Serial.println();
+    seennode(nodeID);
+    recordmeshsync(1, 0, false);
 }
 
 
 /* 
 A Mesh callback function triggered when there is a change to the connections of the mesh. 
 This callback is exclusively used by FyrNode objects.  
-The callback sends a 'connectionupdate' message with updatetype 'changedconnection' to mesh control node which handles the mesh synchronization.
+The callback records a 'changedconnection' change, which is reported in a coalesced 'connectionupdate' message to mesh control node which handles the mesh synchronization.
 Refer to the API documentation for more information about the 'meshlog' structure.
 */
 void meshcallback_changedconnection() 
 {
-    sendmessage_connectionupdate("changedconnection");
+    recordconnectionupdate(IMC_UPDATE_CHANGEDCONNECTION);
 }
 
 
 /* 
 A Mesh callback function triggered when there is a change to the connections of the mesh. 
 This callback is exclusively used by FyrNodeControl objects. 
-The callback generates a 'meshlog' document of type 'meshsync' with the sync set to 'changedconnection' and logs it to the Serial.
+The callback records a 'changedconnection' change into the coalesced 'meshsync' meshlog.
 Refer to the API documentation for more information about the 'meshlog' structure.
 */
 void meshcallback_controlnode_changedconnection() 
 {
-    // Create the meshlog document
-    StaticJsonDocument<512> logdoc;
-    logdoc["type"] = "meshlog";
-    logdoc["nodeID"] = mesh.getNodeId();
-    logdoc["nodetime"] = mesh.getNodeTime();
-    // Fill in the meshlog values
-    logdoc["logdata"]["type"] = "meshsync";
-    logdoc["logdata"]["sync"] = "changedconnection";
-    logdoc["logdata"]["message"] = "mesh synchronization required";
-    // Log the document to the Serial port.
-    serializeJson(logdoc, Serial); Serial.println();
+    recordmeshsync(0, 1, false);
 }
 
 
@@ -674,108 +4262,154 @@ Refer to the API documentation for more information about the 'meshlog' structur
 void meshcallback_nodetimeadjust(int32_t offset) 
 {
     // Create the meshlog document
-    StaticJsonDocument<512> logdoc;
-    logdoc["type"] = "meshlog";
-    logdoc["nodeID"] = mesh.getNodeId();
-    logdoc["nodetime"] = mesh.getNodeTime();
+    JsonDocument &logdoc = beginmeshlog("nodesync", "node time adjusted and synchronised");
     // Fill in the meshlog values
-    logdoc["logdata"]["type"] = "nodesync";
-    logdoc["logdata"]["message"] = "node time adjusted and synchronised";
     logdoc["logdata"]["nodetime"] = mesh.getNodeTime();
     logdoc["logdata"]["offset"] = offset;
     // Log the document to the Serial port.
-    serializeJson(logdoc, Serial); Serial.println();
+    endmeshlog(logdoc);
 }
 
 
-/* 
-A Mesh callback function triggered when a message has been received by the node. 
-This callback is exclusively used by FyrNode objects. 
-The callback prints the received message to the Serial for logging and deserializes it into 
-a JSON document and calls the appropriate 'handlemessage_' runtime to handle the received message. 
-Refer to the API documentation for more information about message handler runtimes.
+// A function pointer type for the 'handlemessage_' runtimes.
+typedef void (*messagehandler)(MeshFrame &message);
+
+// The message handler table for FyrNode objects, indexed by the IMC message type.
+const messagehandler NODEHANDLERS[] = {
+    NULL,                           // IMC_UNKNOWN
+    handlemessage_meshcommand,      // IMC_MESHCOMMAND
+    NULL,                           // IMC_HANDSHAKE
+    handlemessage_handshakeACK,     // IMC_HANDSHAKEACK
+    NULL,                           // IMC_SENSORDATA
+    NULL,                           // IMC_CONFIGDATA
+    NULL,                           // IMC_CONNECTIONUPDATE
+    NULL,                           // IMC_HISTORYDATA
+    NULL,                           // IMC_ACK
+    NULL,                           // IMC_PROFILEDATA
+    NULL                            // IMC_NODEMETRICS
+};
+
+// The message handler table for FyrNodeControl objects, indexed by the IMC message type.
+const messagehandler CONTROLNODEHANDLERS[] = {
+    NULL,                           // IMC_UNKNOWN
+    NULL,                           // IMC_MESHCOMMAND
+    handlemessage_handshake,        // IMC_HANDSHAKE
+    NULL,                           // IMC_HANDSHAKEACK
+    handlemessage_sensordata,       // IMC_SENSORDATA
+    handlemessage_configdata,       // IMC_CONFIGDATA
+    handlemessage_connectionupdate, // IMC_CONNECTIONUPDATE
+    handlemessage_historydata,      // IMC_HISTORYDATA
+    NULL,                           // IMC_ACK
+    handlemessage_profiledata,      // IMC_PROFILEDATA
+    handlemessage_nodemetrics       // IMC_NODEMETRICS
+};
+
+
+/*
+A function that checks whether a received message is worth decoding from its header alone. Multicast messages 
+for other groups and messages whose type has no handler in the table, such as the handshakes that other nodes 
+broadcast, are counted and dropped silently. Acks are always accepted for the reliable unicast layer.
+*/
+bool acceptmeshmessage(const messagehandler handlers[], uint8_t handlercount, String &receivedmessage)
+{
+    // Frames with an unreadable header are left to the decoder
+    uint8_t type; uint8_t reach; uint32_t destination;
+    if (!peekframeheader(receivedmessage.c_str(), receivedmessage.length(), type, reach, destination)) {return true;}
+
+    bool addressed = reach != IMC_MULTICAST || (MESH_GROUP != 0 && destination == (uint32_t)MESH_GROUP);
+    bool handled = type == IMC_ACK || (type < handlercount && handlers[type] != NULL);
+    if (addressed && handled) {return true;}
+
+    // Count the dropped message
+    countreceive(type, reach, receivedmessage.length());
+    RXFILTERED++;
+    return false;
+}
+
+/*
+A function that decodes a received message and dispatches it through a message handler table. When prefilter 
+is set, messages are first filtered by the type and group in their header. Messages that cannot be decoded or 
+have no handler are logged to the Serial.
 */
-void meshcallback_messagerx(uint32_t from, String &receivedmessage) 
+void dispatchmeshmessage(const messagehandler handlers[], uint8_t handlercount, String &receivedmessage, bool prefilter)
 {
-    // Create a document and deserialize the received message
-    DynamicJsonDocument message(512);
-    deserializeJson(message, receivedmessage);
-    // Detect the type of the received message
-    String messagetype = message["data"]["type"];
+    // Drop messages that are not for this node before decoding them
+    if (prefilter && !acceptmeshmessage(handlers, handlercount, receivedmessage)) {return;}
+
+    // Record the time the message handling started
+    uint32_t started = micros();
+    // Create a frame and decode the received message
+    PooledFrame message;
+    if (!message.valid()) {return;}
+    bool decoded = message->decode(receivedmessage.c_str(), receivedmessage.length());
+    // Detect the type of the received message and count it
+    uint8_t messagetype = decoded ? message->type : (uint8_t)IMC_UNKNOWN;
+    countreceive(messagetype, decoded ? message->reach : 0, receivedmessage.length());
+    if (!decoded) {RXINVALID++;}
 
-    // Check the messagetype and call the appropriate runtime
-    if (messagetype == "meshcommand") {
-        // Call the 'meshcommand' message handler
-        handlemessage_meshcommand(message);
-    } 
-    else if (messagetype == "handshakeACK") {
-        // Call the 'handshakeACK' message handler
-        handlemessage_handshakeACK(message);
+    // Run the reliable unicast layer, which consumes acks and duplicate messages
+    bool consumed = decoded && consumereliable(*message);
+
+    // Call the appropriate runtime from the handler table
+    if (consumed) {
+        // The message has been handled by the reliable unicast layer
+    }
+    else if (messagetype < handlercount && handlers[messagetype] != NULL) {
+        handlers[messagetype](*message);
     }
     else {
+        if (decoded) {RXUNHANDLED++;}
         // Create the meshlog document for the message of unknown type
-        StaticJsonDocument<512> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
+        JsonDocument &logdoc = beginmeshlog("messagerx", "message received");
         // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "messagerx";
-        logdoc["logdata"]["message"] = "message received";
-        logdoc["logdata"]["rxtype"] = messagetype;
+        logdoc["logdata"]["rxtype"] = decoded ? lookupname(MESSAGETYPES, TABLESIZE(MESSAGETYPES), messagetype) : "invalid";
         // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
+        endmeshlog(logdoc);
     }
+
+    // Record the handling time and the heap low water mark after handling the message
+    recorddispatch(MESSAGESTATS[messagetype < TABLESIZE(MESSAGESTATS) ? messagetype : (uint8_t)IMC_UNKNOWN], started);
+    trackheap();
+}
+
+
+/* 
+A Mesh callback function triggered when a message has been received by the node. 
+This callback is exclusively used by FyrNode objects. 
+The callback dispatches the received messages through the NODEHANDLERS table. Multicast messages for 
+other groups and messages that a sensor node has no handler for, like the handshakes of other nodes, 
+are discarded after decoding only their header.
+Refer to the API documentation for more information about message handler runtimes.
+*/
+void meshcallback_messagerx(uint32_t from, String &receivedmessage)
+{
+    dispatchmeshmessage(NODEHANDLERS, TABLESIZE(NODEHANDLERS), receivedmessage, true);
 }
 
 
 /* 
 A Mesh callback function triggered when a message has been received by a control node. 
 This callback is exclusively used by FyrNodeControl objects. 
-The callback prints the received message to the Serial for logging and deserializes it into 
-a JSON document and calls the appropriate 'handlemessage_' runtime to handle the received message. 
+The callback records the sender in the node registry and dispatches the received message through the CONTROLNODEHANDLERS table.
+Received messages are not filtered from their header, so messages without a handler, such as the meshcommands 
+broadcast by the PINGER buttons of sensor nodes, are logged to the Serial.
 Refer to the API documentation for more information about message handler runtimes.
 */
-void meshcallback_controlnode_messagerx(uint32_t from, String &receivedmessage) 
+void meshcallback_controlnode_messagerx(uint32_t from, String &receivedmessage)
 {
-    // Create a document and deserialize the received message
-    DynamicJsonDocument message(512);
-    deserializeJson(message, receivedmessage);
-    // Detect the type of the received message
-    String messagetype = message["data"]["type"];
-
-    // Check the messagetype and call the appropriate runtime
-    if (messagetype == "handshake") {
-        // Call the 'handshake' message handler
-        handlemessage_handshake(message);
-    } 
-    else if (messagetype == "sensordata") {
-        // Call the 'sensordata' message handler
-        handlemessage_sensordata(message);
-    }
-    else if (messagetype == "configdata") {
-        // Call the 'configdata' message handler
-        handlemessage_configdata(message);
-    }
-    else if (messagetype == "connectionupdate") {
-        // Call the 'connectionupdate' message handler
-        handlemessage_connectionupdate(message);
-    }
-    else {
-        // Create the meshlog document for the message of unknowntype
-        StaticJsonDocument<512> logdoc;
-        logdoc["type"] = "meshlog";
-        logdoc["nodeID"] = mesh.getNodeId();
-        logdoc["nodetime"] = mesh.getNodeTime();
-        // Fill in the meshlog values
-        logdoc["logdata"]["type"] = "messagerx";
-        logdoc["logdata"]["message"] = "message received";
-        logdoc["logdata"]["rxtype"] = messagetype;
-        // Log the document to the Serial port.
-        serializeJson(logdoc, Serial); Serial.println();
-    }
+    // Record the node in the node registry
+    seennode(from);
+    dispatchmeshmessage(CONTROLNODEHANDLERS, TABLESIZE(CONTROLNODEHANDLERS), receivedmessage, false);
 }
 
 
+#if BUTTONDRIVER_PINGER
+// A function that initialises the button attached to PINGERPIN.
+void initbutton_pinger()
+{
+    pingerButton.begin();
+}
+
 /*
 A button check runtime that reads the button attached to PINGERPIN on any node.
 Sends the 'readsensors' command if the button has been pressed.
@@ -787,46 +4421,77 @@ void checkbutton_pinger() {
     // On button press
     if (pingerButton.wasReleased()) {
         // Send the 'readsensor' command
-        String pingid = "buttonping-" + String(random(100000,999999));
+        char pingid[IMC_MAXPING + 1];
+        snprintf(pingid, sizeof(pingid), "buttonping-%ld", random(100000,999999));
         sendcommand_readsensors(0, pingid);
     }
 }
+#else
+// Empty button runtimes for builds without the PINGER button driver.
+void initbutton_pinger() {}
+void checkbutton_pinger() {}
+#endif
 
 
 /*
-A function that runs the handshake runtime. 
-Checks the handshaketimer's value and increments it if its under the limit. 
-If the limit is exceeded, a message of type 'handshake' is generated and broadcast to the whole mesh. 
-The handshaketimer is also reset everytime the message is broadcast.
+A function that runs the handshake runtime. Called by the handshaketask on the meshScheduler.
+If the MESHCONTROLNODE global has been set, the task disables itself and no handshake is sent.
+Otherwise a message of type 'handshake' is generated and broadcast to the whole mesh, and the 
+next run is rescheduled with an exponential backoff (capped at HANDSHAKE_MAXINTERVAL) plus a 
+random jitter of up to half the interval, so that nodes powered up together drift apart.
 Refer to the API documentation for more information about the handshake runtime.
 */
 void runhandshake()
 {
-    // Check if the handshaketimer has run out
-    if (handshaketimer < 100000) {
-        // Increment the timer
-        handshaketimer++;
-    } else {
-        // Create a handshake message document
-        DynamicJsonDocument handshake(512);
-        handshake["type"] = "message";
-        handshake["origin"] = mesh.getNodeId();
-        // Set the reach parameters to broadcast
-        handshake["reach"]["type"] = "broadcast";
-        // Set the message type and message
-        handshake["data"]["type"] = "handshake";
-        handshake["data"]["message"] = "handshake requested";
-        // Reset the handshaketimer
-        handshaketimer = 0;
+    // Stop the handshake runtime once the MESHCONTROLNODE value has been acquired
+    if (MESHCONTROLNODE > 0) {
+        handshaketask.disable();
+        return;
+    }
+
+    // Create a handshake message broadcast to the mesh
+    PooledFrame handshake;
+    if (handshake.valid()) {
+        handshake->begin(IMC_HANDSHAKE, IMC_BROADCAST, mesh.getNodeId(), 0, NULL);
+        handshake->addu32(IMC_FIELD_CONFIGHASH, CONFIGHASH);
+        if (MESH_GROUP > 0) {handshake->addu32(IMC_FIELD_GROUP, MESH_GROUP);}
         // Transmit the handshake
-        sendmeshmessage(handshake);
+        sendmeshmessage(*handshake);
     }
+
+    // Double the backoff interval up to the limit and reschedule with jitter
+    HANDSHAKEINTERVAL = HANDSHAKEINTERVAL * 2;
+    if (HANDSHAKEINTERVAL > HANDSHAKE_MAXINTERVAL) {HANDSHAKEINTERVAL = HANDSHAKE_MAXINTERVAL;}
+    handshaketask.setInterval(HANDSHAKEINTERVAL + random(HANDSHAKEINTERVAL / 2));
+}
+
+
+/*
+A function that starts the handshake runtime on the meshScheduler.
+The random generator is seeded from the node ID in begin() so that the jitter differs between nodes 
+and the first handshake is delayed by a random amount up to HANDSHAKE_STARTDELAY.
+*/
+void starthandshake()
+{
+    // Reset the backoff interval
+    HANDSHAKEINTERVAL = HANDSHAKE_MININTERVAL;
+    handshaketask.setInterval(HANDSHAKEINTERVAL);
+    // Add the tasks to the scheduler and enable them
+    meshScheduler.addTask(handshaketask);
+    meshScheduler.addTask(connectiontask);
+    handshaketask.enableDelayed(random(HANDSHAKE_STARTDELAY));
+    connectiontask.enable();
 }
 
 
 // A function that check the MESHCONNECTED global flag and sets the LED on the CONNECTLEDPIN
 void setconnectionLED()
 {
+    // Only write the pin when the MESHCONNECTED value has changed
+    static int8_t ledstate = -1;
+    if (ledstate == MESHCONNECTED) {return;}
+    ledstate = MESHCONNECTED;
+
     // Check if the MESHCONNECTED value is True
     if (MESHCONNECTED == true) {
         // Set the LED to ON
@@ -840,9 +4505,9 @@ void setconnectionLED()
 
 /*
 A function that checks if the node is currently connected to 'larger' mesh.
-This is achieved by first checking if the MESHCONTROLNODE global has been set.
+Called periodically by the connectiontask on the meshScheduler.
 
-If it has not been set, the handshake runtime is called.
+If the MESHCONTROLNODE global has not been set, the handshake runtime is still pending.
 If it has been set, the mesh control node can be verified to be connected to the mesh object.
 */
 void checkmeshconnection()
@@ -851,44 +4516,87 @@ void checkmeshconnection()
     if (MESHCONTROLNODE > 0) {
         // Set the connection bool
         MESHCONNECTED = mesh.isConnected(MESHCONTROLNODE);
-    } else {
-        // Run the handshake runtime to acquire the MESHCONTROLNODE value
-        runhandshake();
     }
 }
 
 
 /*
-A function that checks the Serial port for messages from the controller.
-The message is deserialized, and the type is checked and the appropriate handler is called. 
-If the deserialization fails, the Serial buffer is flushed.
+A function that parses a complete line from the controller and handles it if it is a 'controlcommand'.
+The line is deserialized in place into the preallocated command document. Lines that cannot be 
+deserialized are counted as malformed and skipped without affecting the lines that follow them.
+*/
+void handlecontrollerline(char *line, uint16_t length)
+{
+    CONTROLLINES++;
+    // Deserialize the line into the preallocated command document and time it
+    uint32_t started = micros();
+    DeserializationError error = deserializeJson(COMMANDDOC, line, length);
+    uint32_t parsemicros = micros() - started;
+
+    // Check for Deserialization Error
+    if (error != DeserializationError::Ok) {
+        CONTROLMALFORMED++;
+        return;
+    }
+    // Handle valid 'controlcommand' messages
+    if (COMMANDDOC["type"] == "controlcommand") {
+        handlecontrolcommand(COMMANDDOC, parsemicros);
+    }
+}
+
+/*
+A function that checks the Serial port for messages from the controller without blocking.
+The bytes available in the Serial buffer are accumulated into the controller line buffer across
+update() calls and every complete newline terminated line is parsed and handled on its own, so that
+several queued commands are handled in one call and a malformed line does not drop the others.
+Every call reads at most CONTROLLINE_MAXBYTES bytes and handles at most CONTROLLINE_MAXLINES lines.
+Lines longer than the line buffer are discarded up to their newline and counted as overlong.
 */
 void checkcontrollermessages()
 {
-    // Check if there is data in the Serial buffer
-    if (Serial.available()) {
-        // Create message document
-        DynamicJsonDocument message(512);
-        // Deserialize the message from the Serial buffer
-        DeserializationError error = deserializeJson(message, Serial);
-
-        // Check for Deserialization Error
-        if (error == DeserializationError::Ok) {
-            // Handle valid 'controlcommand' messages
-            if (message["type"] == "controlcommand") {
-                handlecontrolcommand(message);
-            }
-        } 
-        else { 
-            // Flush Serial buffer until it is empty
-            while (Serial.available() > 0) {
-                Serial.read();
-            } 
-        } 
+    uint16_t bytes = 0; uint8_t lines = 0;
+    while (bytes < CONTROLLINE_MAXBYTES && lines < CONTROLLINE_MAXLINES && Serial.available() > 0) {
+        char character = Serial.read();
+        bytes++;
+
+        // Accumulate the character if it does not end the line
+        if (character != '\n' && character != '\r') {
+            if (CONTROLLINELENGTH < CONTROLLINE_SIZE - 1) {CONTROLLINE[CONTROLLINELENGTH++] = character;}
+            else {CONTROLLINEOVERFLOW = true;}
+            continue;
+        }
+
+        // Handle the completed line, skipping empty lines and discarding overlong lines
+        if (CONTROLLINEOVERFLOW) {
+            CONTROLOVERLONG++;
+        } else if (CONTROLLINELENGTH > 0) {
+            CONTROLLINE[CONTROLLINELENGTH] = '\0';
+            handlecontrollerline(CONTROLLINE, CONTROLLINELENGTH);
+            lines++;
+        }
+        CONTROLLINELENGTH = 0;
+        CONTROLLINEOVERFLOW = false;
     }
 }
 
 
+/*
+A function that allocates the tables only used by the control node: the node registry, the config cache,
+the ping tracker, the node metrics, the sensor batch entries and the fanout nodes. They take about 34KB,
+of which the sensor batch is 12KB and the ping tracker 11KB, so they are allocated once by FyrNodeControl::begin()
+instead of being reserved on every sensor node. The functions that add to a table return NULL until it is allocated.
+*/
+void allocatecontroltables()
+{
+    if (NODEREGISTRY == NULL) {NODEREGISTRY = new NodeRecord[NODEREGISTRY_SIZE]();}
+    if (CONFIGCACHE == NULL) {CONFIGCACHE = new ConfigCacheEntry[CONFIGCACHE_SIZE]();}
+    if (PENDINGPINGS == NULL) {PENDINGPINGS = new PendingPing[PINGTRACKER_SIZE]();}
+    if (NODEMETRICS == NULL) {NODEMETRICS = new NodeMetrics[NODEMETRICS_SIZE]();}
+    if (SENSORBATCH.entries == NULL) {SENSORBATCH.entries = new SensorBatchEntry[SENSORBATCH_MAXNODES]();}
+    if (FANOUT.nodes == NULL) {FANOUT.nodes = new uint32_t[FANOUT_MAXNODES]();}
+}
+
+
 // FyrNode Object Constructor
 FyrNode::FyrNode() 
 {
@@ -906,29 +4614,65 @@ void FyrNode::begin()
 {
     // Initialise the Serial Port
     Serial.begin(SERIALBAUD);
+    // Reserve the transmit payload buffer
+    TXPAYLOAD.reserve(IMC_MAXENCODED);
     // Initialise the Mesh AP
     mesh.init(MESH_SSID, MESH_PSWD, &meshScheduler, MESH_PORT);
+    // Seed the random generator with the unique node ID
+    randomSeed(mesh.getNodeId());
     // Set the Connection LED Pin to Output
     pinMode(CONNECTLEDPIN, OUTPUT);
-    // Initialise Sensor objects and set pins to Input
-    if (DHTTYP > 0) {dht.begin();}
-    if (GASTYP > 0) {pinMode(GASPIN, INPUT);}
-    if (FLMTYP > 0) {pinMode(FLMPIN, INPUT);}
+    // Initialise the sensors of the attached sensor drivers
+    initsensordrivers();
     // Initialise the Button objects
-    if (PINGER == true) {pingerButton.begin();}
+    if (PINGERATTACHED) {initbutton_pinger();}
+    // Compute the config hash sent with the handshake
+    CONFIGHASH = computeconfighash();
+    // Start the handshake and connection check tasks
+    starthandshake();
+    // Start the reliable unicast layer
+    startreliable();
+    // Add the connection update settle window task
+    meshScheduler.addTask(connectionupdatetask);
+    // Take the first sample and start the sensor sampling task
+    runsensorsampling();
+    meshScheduler.addTask(sampletask);
+    sampletask.setInterval(SAMPLE_INTERVAL);
+    sampletask.enable();
+    // Start the sensor history task
+    meshScheduler.addTask(historytask);
+    historytask.setInterval(HISTORY_INTERVAL);
+    historytask.enable();
+    // Add the history reply task
+    meshScheduler.addTask(historyreplytask);
+    historyreplytask.setInterval(HISTORY_REPLYINTERVAL);
+    // Start the push reporting task if a report interval is configured
+    if (REPORTINTERVAL > 0) {
+        meshScheduler.addTask(reporttask);
+        reporttask.setInterval(REPORTINTERVAL);
+        reporttask.enable();
+    }
+    // Start the traffic reporting task if a traffic report interval is configured
+    if (TRAFFIC_REPORTINTERVAL > 0) {
+        meshScheduler.addTask(traffictask);
+        traffictask.setInterval(TRAFFIC_REPORTINTERVAL);
+        traffictask.enable();
+    }
 }
 
 // FyrNode Object Loop Method
 void FyrNode::update() 
 {
-    // Update the Mesh Object
-    mesh.update();
-    // Check the Mesh Connection Status
-    checkmeshconnection();
+    PROFILELOOPBEGIN();
+    // Update the Mesh Object and run the scheduled tasks
+    PROFILESTAGE(PROFILE_MESH, mesh.update());
     // Set the connection LED
-    setconnectionLED();
+    PROFILESTAGE(PROFILE_LED, setconnectionLED());
     // Check Pinger Button
-    if (PINGER == true) {checkbutton_pinger();}
+    if (PINGERATTACHED) {PROFILESTAGE(PROFILE_PINGER, checkbutton_pinger());}
+    // Drain the buffered meshlogs to the Serial port
+    PROFILESTAGE(PROFILE_LOGSINK, LOGSINK.drain(Serial));
+    PROFILELOOPEND();
 }
 
 
@@ -949,25 +4693,50 @@ void FyrNodeControl::begin()
 {
     // Initialise the Serial Port
     Serial.begin(SERIALBAUD);
+    // Reserve the transmit payload buffer
+    TXPAYLOAD.reserve(IMC_MAXENCODED);
     // Initialise the Mesh AP
     mesh.init(MESH_SSID, MESH_PSWD, &meshScheduler, MESH_PORT);
+    // Seed the random generator with the unique node ID
+    randomSeed(mesh.getNodeId());
     // Set the Connection LED Pin to Output
     pinMode(CONNECTLEDPIN, OUTPUT);
     // Set Mesh Variables
     MESHCONTROLNODE = mesh.getNodeId();
+    // Allocate the tables of the control node
+    allocatecontroltables();
     // Initialise the Button objects
-    if (PINGER == true) {pingerButton.begin();}
+    if (PINGERATTACHED) {initbutton_pinger();}
+    // Start the reliable unicast layer
+    startreliable();
+    // Add the mesh synchronization settle window task
+    meshScheduler.addTask(meshsynctask);
+    // Start the ping tracker task
+    meshScheduler.addTask(trackertask);
+    trackertask.setInterval(PINGTRACKER_INTERVAL);
+    trackertask.enable();
+    // Add the fanout task for multi-node control commands
+    meshScheduler.addTask(fanouttask);
+    // Add the config reply task for the 'readconfig-mesh' control command
+    meshScheduler.addTask(configreplytask);
+    configreplytask.setInterval(CONFIGCACHE_REPLYINTERVAL);
 }
 
 // FyrNodeControl Object Loop Method
 void FyrNodeControl::update() 
 {
+    PROFILELOOPBEGIN();
     // Update the Mesh Object
-    mesh.update();
+    PROFILESTAGE(PROFILE_MESH, mesh.update());
     // Check for messages from controller
-    checkcontrollermessages();
+    PROFILESTAGE(PROFILE_CONTROLLER, checkcontrollermessages());
+    // Check the sensor batch deadline
+    PROFILESTAGE(PROFILE_BATCH, checksensorbatch());
     // Set the connection LED
-    setconnectionLED();
+    PROFILESTAGE(PROFILE_LED, setconnectionLED());
     // Check Pinger Button
-    if (PINGER == true) {checkbutton_pinger();}
+    if (PINGERATTACHED) {PROFILESTAGE(PROFILE_PINGER, checkbutton_pinger());}
+    // Drain the buffered meshlogs to the Serial port
+    PROFILESTAGE(PROFILE_LOGSINK, LOGSINK.drain(Serial));
+    PROFILELOOPEND();
 }
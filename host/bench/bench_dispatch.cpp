@@ -0,0 +1,112 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A microbenchmark of the dispatch of control commands and mesh messages. The table lookups of the library
+are compared with the chains of string comparisons they replaced, which compared the command or message
+type name with every name in turn. Every lookup is checked against the chain so that both resolve the same
+entry, and the results are printed as a 'dispatchbench' line of JSON.
+*/
+
+// Dependancies
+#include <chrono>
+#include "hosttest.h"
+#include "fyrnode.cpp"
+
+// The number of lookups timed for every name
+#define DISPATCHBENCH_ITERATIONS 200000
+
+// A function that finds a control command with a chain of string comparisons like the library did before the control command table.
+static int8_t chaincontrolcommand(const char *command)
+{
+    for (uint8_t index = 0; index < TABLESIZE(CONTROLCOMMANDS); index++) {
+        if (strcmp(CONTROLCOMMANDS[index].name, command) == 0) {return index;}
+    }
+    return -1;
+}
+
+// A function that finds a message type from its name with a chain of string comparisons like the library did before the binary format.
+static uint8_t chainmessagetype(const char *messagetype)
+{
+    for (uint8_t type = 1; type < TABLESIZE(MESSAGETYPES); type++) {
+        if (strcmp(MESSAGETYPES[type], messagetype) == 0) {return type;}
+    }
+    return IMC_UNKNOWN;
+}
+
+// A function that times a lookup function over a list of names and returns the mean time of a lookup in nanoseconds.
+template <typename Lookup>
+static double timelookups(const std::vector<const char *> &names, Lookup lookup)
+{
+    volatile int sink = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < DISPATCHBENCH_ITERATIONS; i++) {
+        for (const char *name : names) {sink += lookup(name);}
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+    return elapsed / ((double)DISPATCHBENCH_ITERATIONS * names.size());
+}
+
+HOSTTEST(control_command_table_matches_chain)
+{
+    // Every command of the table and a command that is not in it
+    std::vector<const char *> names;
+    for (const ControlCommandEntry &entry : CONTROLCOMMANDS) {names.push_back(entry.name);}
+    names.push_back("readsensors-unknown");
+    for (const char *name : names) {CHECKEQUAL(findcontrolcommand(name), chaincontrolcommand(name));}
+
+    // The worst case of the chain is the last command of the table
+    std::vector<const char *> last = {CONTROLCOMMANDS[TABLESIZE(CONTROLCOMMANDS) - 1].name};
+
+    double tablens = timelookups(names, findcontrolcommand);
+    double chainns = timelookups(names, chaincontrolcommand);
+    double tablelastns = timelookups(last, findcontrolcommand);
+    double chainlastns = timelookups(last, chaincontrolcommand);
+    printf("{\"dispatchbench\":\"controlcommand\",\"entries\":%zu,\"tablens\":%.1f,\"chainns\":%.1f,\"tablelastns\":%.1f,\"chainlastns\":%.1f}\n",
+           TABLESIZE(CONTROLCOMMANDS), tablens, chainns, tablelastns, chainlastns);
+}
+
+HOSTTEST(message_handler_table_matches_chain)
+{
+    // Every message type of the wire format, dispatched from its type byte or from its name
+    std::vector<const char *> names;
+    for (uint8_t type = 1; type < TABLESIZE(MESSAGETYPES); type++) {names.push_back(MESSAGETYPES[type]);}
+    std::vector<uint8_t> types;
+    for (uint8_t type = 1; type < TABLESIZE(MESSAGETYPES); type++) {types.push_back(type);}
+    for (uint8_t type : types) {CHECKEQUAL(chainmessagetype(MESSAGETYPES[type]), type);}
+
+    // The table lookup reads the handler of the type byte from the header of the frame
+    volatile int sink = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < DISPATCHBENCH_ITERATIONS; i++) {
+        for (uint8_t type : types) {sink += (type < TABLESIZE(CONTROLNODEHANDLERS) && CONTROLNODEHANDLERS[type] != NULL);}
+    }
+    double tablens = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / ((double)DISPATCHBENCH_ITERATIONS * types.size());
+    double chainns = timelookups(names, chainmessagetype);
+    printf("{\"dispatchbench\":\"messagetype\",\"entries\":%zu,\"tablens\":%.1f,\"chainns\":%.1f}\n", types.size(), tablens, chainns);
+}
+
+HOSTTEST_MAIN()
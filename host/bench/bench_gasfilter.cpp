@@ -0,0 +1,135 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A microbenchmark of the GAS filter kernels. Every kernel is checked against a reference computed in double
+precision on windows of analog readings and on windows of the full uint16_t range, where a 32 bit sum of
+squares would overflow, and the time of every kernel on a full window is printed as a 'gasfilterbench'
+line of JSON along with the time of a whole oversampled GAS reading.
+*/
+
+// Dependancies
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "hosttest.h"
+#include "fyrnode.cpp"
+
+// The number of windows filtered by every kernel
+#define GASFILTERBENCH_ITERATIONS 200000
+
+// A function that fills a window with pseudo random values up to the given maximum.
+static void fillwindow(uint16_t *values, uint8_t count, uint32_t maximum, uint32_t seed)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        values[i] = (seed >> 8) % (maximum + 1);
+    }
+}
+
+// A function that computes the population variance of a window in double precision with two passes.
+static double referencevariance(const uint16_t *values, uint8_t count)
+{
+    double mean = 0, variance = 0;
+    for (uint8_t i = 0; i < count; i++) {mean += values[i];}
+    mean /= count;
+    for (uint8_t i = 0; i < count; i++) {variance += (values[i] - mean) * (values[i] - mean);}
+    return variance / count;
+}
+
+// A function that checks the kernels against the reference on a window.
+static void checkwindow(const uint16_t *values, uint8_t count)
+{
+    std::vector<uint16_t> sorted(values, values + count);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (uint16_t value : sorted) {sum += value;}
+
+    uint16_t minimum, maximum;
+    float variance;
+    gasfilter_statistics(values, count, minimum, maximum, variance);
+    CHECKEQUAL(minimum, sorted.front());
+    CHECKEQUAL(maximum, sorted.back());
+    double expected = referencevariance(values, count);
+    CHECK(variance >= 0);
+    CHECK(fabs(variance - expected) <= 1e-6 * expected + 1e-3);
+    CHECKEQUAL(gasfilter_median(values, count), sorted[count / 2]);
+    CHECKEQUAL(gasfilter_mean(values, count), (uint16_t)lround(sum / count));
+}
+
+// A function that times a kernel over a window and returns the mean time of a call in nanoseconds.
+template <typename Kernel>
+static double timekernel(Kernel kernel)
+{
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < GASFILTERBENCH_ITERATIONS; i++) {kernel();}
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / GASFILTERBENCH_ITERATIONS;
+}
+
+HOSTTEST(gas_filter_kernels_match_reference)
+{
+    uint16_t values[GAS_WINDOW];
+    for (uint32_t seed = 1; seed <= 50; seed++) {
+        for (uint8_t count : {(uint8_t)1, (uint8_t)2, (uint8_t)7, (uint8_t)GAS_WINDOW}) {
+            fillwindow(values, count, 1023, seed);
+            checkwindow(values, count);
+            fillwindow(values, count, UINT16_MAX, seed);
+            checkwindow(values, count);
+        }
+    }
+
+    // A constant window has no variance, even where the float mean of the squares would round
+    std::fill(values, values + GAS_WINDOW, 1021);
+    uint16_t minimum, maximum;
+    float variance;
+    gasfilter_statistics(values, GAS_WINDOW, minimum, maximum, variance);
+    CHECKEQUAL(variance, 0.0f);
+}
+
+HOSTTEST(gas_filter_kernels_are_timed)
+{
+    uint16_t values[GAS_WINDOW];
+    fillwindow(values, GAS_WINDOW, 1023, 7);
+    volatile uint32_t sink = 0;
+    uint16_t minimum, maximum;
+    float variance;
+
+    double meanns = timekernel([&]() {sink += gasfilter_mean(values, GAS_WINDOW);});
+    double medianns = timekernel([&]() {sink += gasfilter_median(values, GAS_WINDOW);});
+    double statisticsns = timekernel([&]() {gasfilter_statistics(values, GAS_WINDOW, minimum, maximum, variance); sink += maximum;});
+
+    // A whole reading adds a raw value to the window and filters it
+    SensorSample sample = {};
+    HOSTDEFAULTPLATFORM.analogvalue = 512;
+    double readns = timekernel([&]() {readsensor_GAS(sample); sink += sample.gas;});
+    CHECKEQUAL(sample.gas, 512);
+    CHECKEQUAL(sample.gasvar, 0.0f);
+
+    printf("{\"gasfilterbench\":\"kernels\",\"window\":%d,\"meanns\":%.1f,\"medianns\":%.1f,\"statisticsns\":%.1f,\"readns\":%.1f}\n",
+           GAS_WINDOW, meanns, medianns, statisticsns, readns);
+}
+
+HOSTTEST_MAIN()
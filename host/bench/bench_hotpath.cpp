@@ -0,0 +1,289 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A benchmark of the hot paths of the library on the host. It replays the recorded message corpus through
+the message handlers of the control node and the sensor nodes, runs the recorded controller lines through
+the controller parser and the control commands, and times the command senders, sendmeshmessage() and
+meshlog emission. Every operation is measured for its mean and maximum time and its mean number of heap
+allocations and allocated bytes, and the results are printed as a single JSON document.
+
+    bench_hotpath [passes] [output file]
+
+The corpus is recorded from the mesh simulator by the recordcorpus tool.
+*/
+
+// Dependancies
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "fyrnode.cpp"
+
+// Hot Path Benchmark Configuration Values
+#define HOTPATH_PASSES 200
+#define HOTPATH_CONTROLNODE 3000000001UL
+#define HOTPATH_SENSORNODE 3100000000UL
+#define HOTPATH_PING "controlping123456"
+
+// A structure that holds the measurements of an operation.
+struct HotPathResult
+{
+    uint64_t calls;
+    double totalns;
+    double maxns;
+    uint64_t allocations;
+    uint64_t allocatedbytes;
+};
+
+// A structure that holds a recorded mesh message.
+struct CorpusFrame
+{
+    bool control;
+    uint32_t from;
+    uint32_t destination;
+    std::string type;
+    std::string payload;
+};
+
+// The measurements of every operation, ordered by name
+std::map<std::string, HotPathResult> HOTPATHRESULTS;
+
+// A function that measures a single run of an operation under the given name.
+template <typename Operation>
+void measure(const std::string &name, Operation operation)
+{
+    uint64_t allocations = HOSTHEAP.allocations, allocatedbytes = HOSTHEAP.allocatedbytes;
+    auto started = std::chrono::steady_clock::now();
+    operation();
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+
+    HostHeapExempt exempt;
+    HotPathResult &result = HOTPATHRESULTS[name];
+    result.calls++;
+    result.totalns += elapsed;
+    result.maxns = std::max(result.maxns, elapsed);
+    result.allocations += HOSTHEAP.allocations - allocations;
+    result.allocatedbytes += HOSTHEAP.allocatedbytes - allocatedbytes;
+}
+
+// A function that writes the buffered meshlogs and clears the output of the platform, outside of any measurement.
+void settle()
+{
+    LOGSINK.completestream();
+    for (int i = 0; i < 64; i++) {LOGSINK.drain(Serial);}
+    HostHeapExempt exempt;
+    HOSTDEFAULTPLATFORM.serialoutput.clear();
+    HOSTDEFAULTPLATFORM.sent.clear();
+}
+
+// A function that resets the reliable unicast layer so that replayed messages are not dropped as duplicates.
+void resetreliable()
+{
+    memset(RELIABLESLOTS, 0, sizeof(RELIABLESLOTS));
+    memset(RELIABLESEEN, 0, sizeof(RELIABLESEEN));
+    RELIABLESEENHEAD = 0;
+}
+
+// A function that switches the library to the node with the given ID, the control node or a sensor node.
+void setrole(uint32_t node)
+{
+    HOSTDEFAULTPLATFORM.nodeid = node;
+    MESHCONTROLNODE = HOTPATH_CONTROLNODE;
+}
+
+// A function that reads the recorded mesh messages. Returns false if the corpus cannot be read or holds an invalid frame.
+bool readframes(const std::string &path, std::vector<CorpusFrame> &frames)
+{
+    std::ifstream input(path);
+    std::string role;
+    CorpusFrame frame;
+    while (input >> role >> frame.from >> frame.destination >> frame.payload) {
+        MeshFrame decoded;
+        if (!decoded.decode(frame.payload.c_str(), frame.payload.size())) {return false;}
+        frame.control = (role == "control");
+        frame.type = lookupname(MESSAGETYPES, TABLESIZE(MESSAGETYPES), decoded.type);
+        frames.push_back(frame);
+    }
+    return !frames.empty();
+}
+
+// A function that reads the recorded controller lines. Returns false if the corpus cannot be read.
+bool readlines(const std::string &path, std::vector<std::string> &lines)
+{
+    std::ifstream input(path);
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty()) {lines.push_back(line);}
+    }
+    return !lines.empty();
+}
+
+// A function that replays every recorded mesh message through the handlers of the role that receives it.
+void replayframes(const std::vector<CorpusFrame> &frames)
+{
+    for (const CorpusFrame &frame : frames) {
+        String payload;
+        {
+            HostHeapExempt exempt;
+            payload = frame.payload.c_str();
+        }
+        resetreliable();
+        if (frame.control) {
+            setrole(HOTPATH_CONTROLNODE);
+            measure("handle/" + frame.type, [&]() {meshcallback_controlnode_messagerx(frame.from, payload);});
+        } else {
+            setrole(frame.destination != 0 ? frame.destination : HOTPATH_SENSORNODE);
+            measure("handle/" + frame.type, [&]() {meshcallback_messagerx(frame.from, payload);});
+        }
+        settle();
+        HostHeapExempt exempt;
+        payload = String();
+    }
+}
+
+// A function that runs every recorded controller line through the controller parser of the control node.
+void replaylines(const std::vector<std::string> &lines)
+{
+    setrole(HOTPATH_CONTROLNODE);
+    for (const std::string &line : lines) {
+        // Parse the line on its own to measure the parser apart from the command
+        const char *command;
+        measure("parse/controller", [&]() {deserializeJson(COMMANDDOC, line.c_str(), line.size());});
+        command = COMMANDDOC["command"] | "";
+        std::string name;
+        {
+            HostHeapExempt exempt;
+            name = std::string("controller/") + command;
+        }
+
+        // Feed the line to the Serial port and handle it like the update loop does
+        HOSTDEFAULTPLATFORM.serialfeed(line + "\n");
+        measure(name, [&]() {checkcontrollermessages();});
+        settle();
+    }
+}
+
+// A function that times the command senders, sendmeshmessage() and meshlog emission.
+void runsenders()
+{
+    setrole(HOTPATH_CONTROLNODE);
+    measure("send/readsensors", [&]() {sendcommand_readsensors(HOTPATH_SENSORNODE, HOTPATH_PING);});
+    measure("send/readsensors-broadcast", [&]() {sendcommand_readsensors(0, HOTPATH_PING);});
+    measure("send/readconfig", [&]() {sendcommand_readconfig(HOTPATH_SENSORNODE, HOTPATH_PING);});
+    measure("send/readhistory", [&]() {sendcommand_readhistory(HOTPATH_SENSORNODE, HOTPATH_PING, 0);});
+    measure("send/readprofile", [&]() {sendcommand_readprofile(HOTPATH_SENSORNODE, HOTPATH_PING);});
+    measure("send/readtraffic", [&]() {sendcommand_readtraffic(HOTPATH_SENSORNODE, HOTPATH_PING);});
+    measure("send/group", [&]() {sendcommand_group(IMC_COMMAND_READSENSORS, 1, HOTPATH_PING);});
+    settle();
+
+    // Send a sensordata reply from a sensor node, and the same frame through sendmeshmessage() alone
+    setrole(HOTPATH_SENSORNODE);
+    measure("send/sensordata", [&]() {sendsensordata(SENSORCACHE, HOTPATH_PING);});
+    {
+        PooledFrame sensordata;
+        sensordata->begin(IMC_SENSORDATA, IMC_UNICAST, HOTPATH_SENSORNODE, HOTPATH_CONTROLNODE, HOTPATH_PING);
+        fillsensordata(*sensordata, SENSORCACHE);
+        measure("sendmeshmessage/sensordata", [&]() {sendmeshmessage(*sensordata);});
+    }
+    settle();
+
+    // Emit a meshlog into the log sink and write it to the Serial port
+    measure("meshlog/emit", [&]() {
+        JsonDocument &logdoc = beginmeshlog("sensordata", "sensor data received", LOGPRIORITY_HIGH);
+        logdoc["logdata"]["ping"] = HOTPATH_PING;
+        logdoc["logdata"]["origin"] = HOTPATH_SENSORNODE;
+        logdoc["logdata"]["sensors"]["TEM"] = 27.25f;
+        logdoc["logdata"]["sensors"]["HUM"] = 54.5f;
+        endmeshlog(logdoc);
+    });
+    measure("meshlog/drain", [&]() {LOGSINK.drain(Serial);});
+    settle();
+}
+
+// A function that prints the results as a JSON document.
+void printresults(FILE *output, int passes, size_t frames, size_t lines)
+{
+    fprintf(output, "{\"bench\":\"hotpath\",\"passes\":%d,\"corpusframes\":%zu,\"corpuslines\":%zu,\"results\":[", passes, frames, lines);
+    bool first = true;
+    for (const auto &entry : HOTPATHRESULTS) {
+        const HotPathResult &result = entry.second;
+        fprintf(output, "%s\n{\"name\":\"%s\",\"calls\":%llu,\"meanns\":%.0f,\"maxns\":%.0f,\"allocations\":%.2f,\"allocatedbytes\":%.1f}",
+                first ? "" : ",", entry.first.c_str(), (unsigned long long)result.calls, result.totalns / result.calls, result.maxns,
+                (double)result.allocations / result.calls, (double)result.allocatedbytes / result.calls);
+        first = false;
+    }
+    fprintf(output, "\n]}\n");
+}
+
+int main(int argc, char **argv)
+{
+    int passes = (argc > 1) ? atoi(argv[1]) : HOTPATH_PASSES;
+    std::vector<CorpusFrame> frames;
+    std::vector<std::string> lines;
+    if (!readframes(FYRNODE_CORPUS "/meshframes.txt", frames) || !readlines(FYRNODE_CORPUS "/controllerlines.txt", lines)) {
+        fprintf(stderr, "bench_hotpath: cannot read the corpus in %s\n", FYRNODE_CORPUS);
+        return 1;
+    }
+
+    // Prepare the library like the begin() methods do, without starting the mesh
+    TXPAYLOAD.reserve(IMC_MAXENCODED);
+    allocatecontroltables();
+    Serial.begin(115200);
+
+    // Warm up the pools and registries with a pass that is not measured, then measure every pass
+    replayframes(frames);
+    replaylines(lines);
+    runsenders();
+    HOTPATHRESULTS.clear();
+    for (int pass = 0; pass < passes; pass++) {
+        replayframes(frames);
+        replaylines(lines);
+        runsenders();
+    }
+
+    printresults(stdout, passes, frames.size(), lines.size());
+
+    // Check that every section of the benchmark measured something
+    for (const char *section : {"handle/", "send/", "sendmeshmessage/", "meshlog/", "parse/", "controller/"}) {
+        auto found = HOTPATHRESULTS.lower_bound(section);
+        if (found == HOTPATHRESULTS.end() || found->first.compare(0, strlen(section), section) != 0) {
+            fprintf(stderr, "bench_hotpath: no measurements for %s\n", section);
+            return 1;
+        }
+    }
+    if (argc > 2) {
+        FILE *output = fopen(argv[2], "w");
+        if (output == NULL) {
+            fprintf(stderr, "bench_hotpath: cannot write %s\n", argv[2]);
+            return 1;
+        }
+        printresults(output, passes, frames.size(), lines.size());
+        fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A tool that records the message corpus of the hot path benchmark from a simulated mesh. The mesh runs
+the boot and handshakes of its nodes and a cycle of every control command, and every message sent on
+the mesh is written to 'meshframes.txt' with the role of the nodes that receive it, while the control
+commands are written to 'controllerlines.txt'. The corpus is checked in so that benchmark runs are
+reproducible, run this tool again after a change to the wire format.
+
+    recordcorpus <corpus directory>
+*/
+
+// Dependancies
+#include <stdio.h>
+#include <string>
+#include "meshsim.h"
+
+// The control commands of the recorded cycle, the node commands are sent to the first sensor node
+const char *const RECORDEDCOMMANDS[] = {
+    "readsensors-mesh", "readconfig-mesh", "readsensors-node", "readconfig-node", "readhistory-node",
+    "readprofile-node", "readtraffic-node", "readnodelist-control", "readmemory-control",
+    "readstats-control", "readmetrics-control", "readprofile-control", "readtraffic-control"
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: recordcorpus <corpus directory>\n");
+        return 2;
+    }
+    std::string directory = argv[1];
+    FILE *frames = fopen((directory + "/meshframes.txt").c_str(), "w");
+    FILE *lines = fopen((directory + "/controllerlines.txt").c_str(), "w");
+    if (frames == NULL || lines == NULL) {
+        fprintf(stderr, "recordcorpus: cannot write to %s\n", directory.c_str());
+        return 1;
+    }
+
+    MeshSimConfig config;
+    config.nodes = 12;
+    config.seed = 3;
+    MeshSimulator sim(config);
+
+    // Record every message with the role of its receivers: messages of the control node are received
+    // by the sensor nodes and messages of the sensor nodes are received by the control node
+    sim.ontransmit = [&](SimNode &from, uint32_t destination, bool broadcast, const std::string &payload) {
+        fprintf(frames, "%s %u %u %s\n", from.control ? "node" : "control", from.nodeid, broadcast ? 0 : destination, payload.c_str());
+    };
+
+    sim.start();
+    sim.run(20000);
+    char line[192];
+    for (const char *command : RECORDEDCOMMANDS) {
+        snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"%s\",\"node\":%u,\"ping\":\"controlping%s\"}",
+                 command, sim.node(0).nodeid, command);
+        fprintf(lines, "%s\n", line);
+        sim.controllerline(line);
+        sim.run(1000);
+    }
+    sim.run(6000);
+
+    fclose(frames);
+    fclose(lines);
+    return 0;
+}
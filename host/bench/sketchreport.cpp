@@ -0,0 +1,69 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A loop time report of an example sketch on the host. The sketch is compiled into the report from
+SKETCH_FILE and linked with the library as it is shipped or compiled for the hardware of the sketch with
+the CONFIG_ build flags. The report runs setup() and then loop() on a manual clock that advances by
+SKETCHREPORT_STEP microseconds per loop, and prints the mean time of a loop as a 'sketchreport' line of JSON.
+
+    sketch_<sketch>_<variant> [loops]
+*/
+
+// Dependancies
+#include <chrono>
+#include <stdlib.h>
+#include "hostplatform.h"
+#include SKETCH_FILE
+
+// Sketch Report Configuration Values
+#define SKETCHREPORT_LOOPS 200000
+#define SKETCHREPORT_STEP 1000
+
+int main(int argc, char **argv)
+{
+    long loops = (argc > 1) ? atol(argv[1]) : SKETCHREPORT_LOOPS;
+    HOSTDEFAULTPLATFORM.setmanualclock(0);
+    setup();
+
+    // Run the loop on the advancing clock and time it
+    double elapsed = 0;
+    for (long i = 0; i < loops; i++) {
+        HOSTDEFAULTPLATFORM.advanceclock(SKETCHREPORT_STEP);
+        auto started = std::chrono::steady_clock::now();
+        loop();
+        elapsed += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+
+        // Discard the output of the sketch outside of the timing
+        HostHeapExempt exempt;
+        HOSTDEFAULTPLATFORM.serialoutput.clear();
+        HOSTDEFAULTPLATFORM.sent.clear();
+    }
+
+    printf("{\"sketchreport\":\"%s\",\"variant\":\"%s\",\"loops\":%ld,\"loopns\":%.1f,\"pinwrites\":%u}\n",
+           SKETCH_NAME, SKETCH_VARIANT, loops, elapsed / loops, HOSTDEFAULTPLATFORM.pinwrites);
+    return 0;
+}
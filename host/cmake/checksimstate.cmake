@@ -0,0 +1,18 @@
+# Checks that the simulated node state object keeps all of its writable data in .data and .bss.
+# Writable data in any other section would be shared by every simulated node instead of swapped.
+execute_process(COMMAND ${OBJDUMP} -h -w ${OBJECT} OUTPUT_VARIABLE sections RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Could not read the sections of ${OBJECT}")
+endif()
+
+string(REPLACE "\n" ";" lines "${sections}")
+foreach(line IN LISTS lines)
+  if(NOT line MATCHES "^ *[0-9]+ +([^ ]+) .*ALLOC")
+    continue()
+  endif()
+  set(name ${CMAKE_MATCH_1})
+  if(line MATCHES "READONLY" OR name MATCHES "^\\.(data|bss|init_array|fini_array|data\\.rel\\.ro.*)$")
+    continue()
+  endif()
+  message(FATAL_ERROR "The simulated node state has writable data in ${name}, which the simulator does not swap")
+endforeach()
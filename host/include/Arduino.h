@@ -0,0 +1,204 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A stand-in for the subset of the ESP8266 Arduino core that the library uses.
+Everything that touches the hardware is forwarded to the current HostPlatform.
+*/
+
+#pragma once
+
+#ifndef ARDUINO_H_INCLUDED
+#define ARDUINO_H_INCLUDED
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "hostplatform.h"
+
+// Pin Values
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+#define A0 17
+#define LED_BUILTIN 2
+
+#define F(string) (string)
+
+
+// A stand-in for the Arduino String class backed by a std::string.
+class String
+{
+  public:
+    String() {}
+    String(const char *value) : text(value ? value : "") {}
+    String(const String &value) : text(value.text) {}
+    String(char value) : text(1, value) {}
+    String(int value) : text(std::to_string(value)) {}
+    String(unsigned int value) : text(std::to_string(value)) {}
+    String(long value) : text(std::to_string(value)) {}
+    String(unsigned long value) : text(std::to_string(value)) {}
+    String(float value, unsigned char decimals = 2);
+    String(double value, unsigned char decimals = 2);
+
+    String &operator=(const String &value) {text = value.text; return *this;}
+    String &operator=(const char *value) {text = value ? value : ""; return *this;}
+
+    const char *c_str() const {return text.c_str();}
+    unsigned int length() const {return text.size();}
+    bool reserve(unsigned int size) {text.reserve(size); return true;}
+    bool concat(const char *value, unsigned int length) {text.append(value, length); return true;}
+    bool concat(const String &value) {text += value.text; return true;}
+    bool concat(const char *value) {text += value; return true;}
+    bool concat(char value) {text.push_back(value); return true;}
+    char charAt(unsigned int index) const {return index < text.size() ? text[index] : 0;}
+    char operator[](unsigned int index) const {return charAt(index);}
+    int indexOf(char value) const {size_t at = text.find(value); return at == std::string::npos ? -1 : (int)at;}
+    String substring(unsigned int from) const {return from < text.size() ? String(text.substr(from).c_str()) : String();}
+    String substring(unsigned int from, unsigned int to) const {return from < to && from < text.size() ? String(text.substr(from, to - from).c_str()) : String();}
+    long toInt() const {return atol(text.c_str());}
+    float toFloat() const {return atof(text.c_str());}
+
+    bool equals(const char *value) const {return text == (value ? value : "");}
+    bool operator==(const String &value) const {return text == value.text;}
+    bool operator==(const char *value) const {return equals(value);}
+    bool operator!=(const String &value) const {return text != value.text;}
+    bool operator!=(const char *value) const {return !equals(value);}
+
+    String &operator+=(const String &value) {concat(value); return *this;}
+    String &operator+=(const char *value) {concat(value); return *this;}
+    String &operator+=(char value) {concat(value); return *this;}
+    String &operator+=(int value) {text += std::to_string(value); return *this;}
+    String &operator+=(unsigned int value) {text += std::to_string(value); return *this;}
+    String &operator+=(long value) {text += std::to_string(value); return *this;}
+    String &operator+=(unsigned long value) {text += std::to_string(value); return *this;}
+
+  private:
+    std::string text;
+};
+
+template <typename T> String operator+(const String &left, const T &right) {String result(left); result += right; return result;}
+inline String operator+(const char *left, const String &right) {String result(left); result += right; return result;}
+
+// A stand-in for the String concatenation helper of the ESP8266 core, which ArduinoJson adapts like a String.
+class StringSumHelper : public String
+{
+  public:
+    StringSumHelper(const String &value) : String(value) {}
+    StringSumHelper(const char *value) : String(value) {}
+};
+
+
+// A stand-in for the Arduino Print class.
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t character) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text) {return text ? write((const uint8_t *)text, strlen(text)) : 0;}
+    size_t write(const char *buffer, size_t size) {return write((const uint8_t *)buffer, size);}
+    virtual int availableForWrite() {return 0;}
+    virtual void flush() {}
+
+    size_t print(const char *text) {return write(text);}
+    size_t print(const String &text) {return write(text.c_str());}
+    size_t print(char character) {return write((uint8_t)character);}
+    size_t print(int value) {return printformat("%d", value);}
+    size_t print(unsigned int value) {return printformat("%u", value);}
+    size_t print(long value) {return printformat("%ld", value);}
+    size_t print(unsigned long value) {return printformat("%lu", value);}
+    size_t print(long long value) {return printformat("%lld", value);}
+    size_t print(unsigned long long value) {return printformat("%llu", value);}
+    size_t print(double value, int decimals = 2);
+
+    size_t println() {return write("\r\n");}
+    template <typename T> size_t println(const T &value) {size_t n = print(value); return n + println();}
+
+  private:
+    size_t printformat(const char *format, ...);
+};
+
+// A stand-in for the Arduino Stream class.
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    size_t readBytes(char *buffer, size_t size);
+};
+
+// A stand-in for the ESP8266 HardwareSerial class that forwards to the current platform.
+class HardwareSerial : public Stream
+{
+  public:
+    void begin(unsigned long baud) {HOSTPLATFORM->serialbegin(baud);}
+    size_t write(uint8_t character) override {return HOSTPLATFORM->serialwrite(&character, 1);}
+    size_t write(const uint8_t *buffer, size_t size) override {return HOSTPLATFORM->serialwrite(buffer, size);}
+    using Print::write;
+    int availableForWrite() override {return HOSTPLATFORM->serialavailableforwrite();}
+    int available() override {return HOSTPLATFORM->serialavailable();}
+    int read() override {return HOSTPLATFORM->serialread();}
+    int peek() override {return HOSTPLATFORM->serialpeek();}
+    operator bool() const {return true;}
+};
+
+// A stand-in for the ESP8266 EspClass that forwards to the current platform.
+class EspClass
+{
+  public:
+    uint32_t getFreeHeap() {return HOSTPLATFORM->freeheap();}
+    uint32_t getCycleCount() {return HOSTPLATFORM->cyclecount();}
+    uint8_t getCpuFreqMHz() {return HOSTPLATFORM->cpumhz();}
+    uint32_t getChipId() {return HOSTPLATFORM->meshnodeid();}
+};
+
+// Global Core Objects
+extern HardwareSerial Serial;
+extern EspClass ESP;
+
+// Core Functions
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long milliseconds);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+int analogRead(uint8_t pin);
+
+#endif
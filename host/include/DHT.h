@@ -0,0 +1,32 @@
+/*
+A stand-in for the Adafruit DHT library that reads the temperature and humidity of the current platform.
+*/
+
+#pragma once
+
+#ifndef DHT_H_INCLUDED
+#define DHT_H_INCLUDED
+
+#include "Arduino.h"
+
+// Sensor Type Values
+#define DHT11 11
+#define DHT12 12
+#define DHT21 21
+#define DHT22 22
+#define AM2301 21
+
+class DHT
+{
+  public:
+    DHT(uint8_t pin, uint8_t type, uint8_t count = 6) : pin(pin), type(type) {}
+    void begin(uint8_t usec = 55) {}
+    float readTemperature(bool fahrenheit = false, bool force = false) {return HOSTPLATFORM->dhttemperature();}
+    float readHumidity(bool force = false) {return HOSTPLATFORM->dhthumidity();}
+
+  private:
+    uint8_t pin;
+    uint8_t type;
+};
+
+#endif
@@ -0,0 +1,36 @@
+/*
+A stand-in for the JC_Button library that reads the button from the digital pins of the current platform.
+Debouncing is not simulated, every read() reports the level of the pin.
+*/
+
+#pragma once
+
+#ifndef JC_BUTTON_H_INCLUDED
+#define JC_BUTTON_H_INCLUDED
+
+#include "Arduino.h"
+
+class Button
+{
+  public:
+    Button(uint8_t pin, uint32_t dbTime = 25, uint8_t puEnable = true, uint8_t invert = true)
+        : pin(pin), invert(invert), state(false), laststate(false), changed(false) {}
+
+    void begin() {pinMode(pin, INPUT_PULLUP); state = laststate = level(); changed = false;}
+    bool read() {laststate = state; state = level(); changed = state != laststate; return state;}
+    bool isPressed() {return state;}
+    bool isReleased() {return !state;}
+    bool wasPressed() {return state && changed;}
+    bool wasReleased() {return !state && changed;}
+
+  private:
+    bool level() {return invert ? digitalRead(pin) == LOW : digitalRead(pin) == HIGH;}
+
+    uint8_t pin;
+    bool invert;
+    bool state;
+    bool laststate;
+    bool changed;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+The platform of the host build. The stand-in Arduino, painlessMesh, DHT and JC_Button headers
+hold no state of their own and forward every hardware and network access to the HostPlatform
+object that HOSTPLATFORM points to. The default platform runs on the host clock, collects the
+Serial output and the sent mesh messages, and lets a test queue received messages and input.
+The mesh simulator swaps HOSTPLATFORM to the node that is currently running.
+*/
+
+#pragma once
+
+#ifndef HOSTPLATFORM_H_INCLUDED
+#define HOSTPLATFORM_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+class painlessMesh;
+
+// Host Platform Configuration Values
+#define HOSTPLATFORM_PINS 32
+#define HOSTPLATFORM_HEAPSIZE 40960
+#define HOSTPLATFORM_CPUMHZ 80
+#define HOSTPLATFORM_NODEID 1000001
+
+// A structure that holds a mesh message sent or received by a host platform.
+struct HostMessage
+{
+    uint32_t node;
+    bool broadcast;
+    std::string payload;
+};
+
+// A structure that holds the heap usage of a host platform. The global new and delete operators account every allocation to HOSTHEAPACCOUNT.
+struct HostHeapAccount
+{
+    size_t live;
+    size_t peak;
+    uint64_t allocations;
+    uint64_t allocatedbytes;
+};
+
+// Global Heap Accounts
+extern HostHeapAccount HOSTHEAP;
+extern HostHeapAccount *HOSTHEAPACCOUNT;
+
+/*
+A class that exempts the allocations of the host harness from the current heap account while it is in scope.
+Used by the platform when it buffers output so that only the allocations of the library are accounted.
+*/
+class HostHeapExempt
+{
+  public:
+    HostHeapExempt();
+    ~HostHeapExempt();
+
+  private:
+    HostHeapAccount *saved;
+};
+
+// A function that resets the counters of a heap account except for its live bytes.
+void resetheapaccount(HostHeapAccount &account);
+
+
+/*
+A class that provides the hardware and the mesh to the library on the host.
+Every method can be overridden, the defaults describe a single node that is not connected to any mesh.
+*/
+class HostPlatform
+{
+  public:
+    HostPlatform();
+    virtual ~HostPlatform() {}
+
+    // Clock
+    virtual uint64_t hostmicros();
+    void setmanualclock(uint64_t micros);
+    void advanceclock(uint64_t micros);
+
+    // Core
+    virtual uint32_t freeheap();
+    virtual uint32_t cyclecount();
+    virtual uint8_t cpumhz() {return HOSTPLATFORM_CPUMHZ;}
+    virtual uint32_t randomnumber();
+    virtual void randomseed(uint32_t seed) {randomstate = seed ? seed : 1;}
+
+    // Serial
+    virtual void serialbegin(unsigned long baud) {serialbaud = baud;}
+    virtual size_t serialwrite(const uint8_t *buffer, size_t size);
+    virtual int serialavailableforwrite() {return serialtxspace;}
+    virtual int serialavailable() {return serialinput.size();}
+    virtual int serialread();
+    virtual int serialpeek() {return serialinput.empty() ? -1 : (uint8_t)serialinput.front();}
+    void serialfeed(const std::string &input) {HostHeapExempt exempt; serialinput.insert(serialinput.end(), input.begin(), input.end());}
+
+    // Pins
+    virtual void pinmode(uint8_t pin, uint8_t mode);
+    virtual int digitalread(uint8_t pin) {return pin < HOSTPLATFORM_PINS ? pinlevels[pin] : 0;}
+    virtual void digitalwrite(uint8_t pin, uint8_t level);
+    virtual int analogread(uint8_t pin) {return analogvalue;}
+    virtual float dhttemperature() {return temperature;}
+    virtual float dhthumidity() {return humidity;}
+
+    // Mesh
+    virtual uint32_t meshnodeid() {return nodeid;}
+    virtual uint32_t meshnodetime() {return (uint32_t)hostmicros();}
+    virtual bool meshsend(uint32_t destination, bool broadcast, const char *payload, size_t length);
+    virtual void meshnodes(std::vector<uint32_t> &nodes) {nodes = peers;}
+    virtual bool meshconnected(uint32_t node);
+    virtual void meshupdate(painlessMesh &mesh);
+    void meshfeed(uint32_t from, const std::string &payload) {HostHeapExempt exempt; received.push_back(HostMessage{from, false, payload});}
+
+    // State of the default platform
+    uint32_t nodeid;
+    uint64_t clockmicros;
+    bool manualclock;
+    uint32_t randomstate;
+    uint32_t heapsize;
+    HostHeapAccount *heap;
+
+    unsigned long serialbaud;
+    int serialtxspace;
+    std::string serialoutput;
+    std::deque<char> serialinput;
+
+    uint8_t pinmodes[HOSTPLATFORM_PINS];
+    uint8_t pinlevels[HOSTPLATFORM_PINS];
+    uint32_t pinwrites;
+    int analogvalue;
+    float temperature;
+    float humidity;
+
+    std::vector<uint32_t> peers;
+    std::vector<HostMessage> sent;
+    std::deque<HostMessage> received;
+};
+
+// Global Host Platform
+extern HostPlatform HOSTDEFAULTPLATFORM;
+extern HostPlatform *HOSTPLATFORM;
+
+#endif
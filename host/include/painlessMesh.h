@@ -0,0 +1,175 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A stand-in for painlessMesh and the TaskScheduler it bundles.
+The Task and Scheduler classes follow the scheduling rules of TaskScheduler with its default options:
+an enabled task runs immediately, a delayed task runs after its delay, runs are scheduled from the
+previous run so that late runs catch up, and a task whose iterations have run out is disabled on
+the next pass of the scheduler. The mesh forwards its traffic to the current HostPlatform, which
+delivers received messages and connection events from update().
+*/
+
+#pragma once
+
+#ifndef PAINLESSMESH_H_INCLUDED
+#define PAINLESSMESH_H_INCLUDED
+
+#include <list>
+#include "Arduino.h"
+
+// TaskScheduler Values
+#define TASK_IMMEDIATE 0
+#define TASK_MILLISECOND 1UL
+#define TASK_SECOND 1000UL
+#define TASK_MINUTE 60000UL
+#define TASK_HOUR 3600000UL
+#define TASK_FOREVER (-1)
+#define TASK_ONCE 1
+
+// Scheduler Configuration Values
+#define SCHEDULER_MAXTASKS 32
+
+// painlessMesh Debug Message Types
+enum DebugType
+{
+    ERROR = 1 << 0,
+    STARTUP = 1 << 1,
+    MESH_STATUS = 1 << 2,
+    CONNECTION = 1 << 3,
+    SYNC = 1 << 4,
+    COMMUNICATION = 1 << 5,
+    GENERAL = 1 << 6,
+    MSG_TYPES = 1 << 7,
+    REMOTE = 1 << 8,
+    APPLICATION = 1 << 9,
+    DEBUG = 1 << 10
+};
+
+class Scheduler;
+
+// A stand-in for the TaskScheduler Task class.
+class Task
+{
+  public:
+    Task(unsigned long interval = 0, long iterations = 0, void (*callback)() = NULL, Scheduler *scheduler = NULL, bool enable = false);
+
+    bool enable();
+    bool enableDelayed(unsigned long delay = 0);
+    bool disable();
+    bool restart();
+    bool restartDelayed(unsigned long delay = 0);
+    void delay(unsigned long delay = 0);
+    void forceNextIteration();
+    bool isEnabled() {return enabled;}
+
+    void setInterval(unsigned long interval);
+    unsigned long getInterval() {return interval;}
+    void setIterations(long iterations) {this->iterations = setiterations = iterations;}
+    long getIterations() {return iterations;}
+    unsigned long getRunCounter() {return runcounter;}
+    void setCallback(void (*callback)()) {this->callback = callback;}
+
+  private:
+    friend class Scheduler;
+
+    unsigned long interval;
+    unsigned long delayvalue;
+    long iterations;
+    long setiterations;
+    unsigned long previous;
+    unsigned long runcounter;
+    bool enabled;
+    void (*callback)();
+    Scheduler *scheduler;
+};
+
+// A stand-in for the TaskScheduler Scheduler class.
+class Scheduler
+{
+  public:
+    Scheduler() : taskcount(0) {}
+
+    void init() {taskcount = 0;}
+    void addTask(Task &task);
+    void deleteTask(Task &task);
+    bool execute();
+
+    // The number of milliseconds until the next enabled task is due, or UINT32_MAX if no task is enabled.
+    uint32_t hostnextdue();
+
+  private:
+    Task *tasks[SCHEDULER_MAXTASKS];
+    uint8_t taskcount;
+};
+
+
+// painlessMesh Callback Types
+typedef void (*receivedCallback_t)(uint32_t from, String &msg);
+typedef void (*newConnectionCallback_t)(uint32_t nodeId);
+typedef void (*changedConnectionsCallback_t)();
+typedef void (*nodeTimeAdjustedCallback_t)(int32_t offset);
+
+// A stand-in for painlessMesh that forwards its traffic to the current platform.
+class painlessMesh
+{
+  public:
+    painlessMesh() : scheduler(NULL), received(NULL), newconnection(NULL), changedconnections(NULL), timeadjusted(NULL) {}
+
+    void setDebugMsgTypes(uint16_t types) {}
+    void init(String ssid, String password, Scheduler *scheduler, uint16_t port = 5555) {this->scheduler = scheduler;}
+    void update();
+    void stop() {}
+
+    bool sendSingle(uint32_t destId, String msg) {return HOSTPLATFORM->meshsend(destId, false, msg.c_str(), msg.length());}
+    bool sendBroadcast(String msg, bool includeSelf = false) {return HOSTPLATFORM->meshsend(0, true, msg.c_str(), msg.length());}
+
+    uint32_t getNodeId() {return HOSTPLATFORM->meshnodeid();}
+    uint32_t getNodeTime() {return HOSTPLATFORM->meshnodetime();}
+    std::list<uint32_t> getNodeList(bool includeSelf = false);
+    bool isConnected(uint32_t nodeId) {return HOSTPLATFORM->meshconnected(nodeId);}
+
+    void onReceive(receivedCallback_t callback) {received = callback;}
+    void onNewConnection(newConnectionCallback_t callback) {newconnection = callback;}
+    void onChangedConnections(changedConnectionsCallback_t callback) {changedconnections = callback;}
+    void onNodeTimeAdjusted(nodeTimeAdjustedCallback_t callback) {timeadjusted = callback;}
+
+    // Entry points used by the platforms to deliver mesh events to the callbacks of the library.
+    void hostreceive(uint32_t from, String &msg) {if (received) {received(from, msg);}}
+    void hostnewconnection(uint32_t nodeId) {if (newconnection) {newconnection(nodeId);}}
+    void hostchangedconnections() {if (changedconnections) {changedconnections();}}
+    void hosttimeadjusted(int32_t offset) {if (timeadjusted) {timeadjusted(offset);}}
+    Scheduler *hostscheduler() {return scheduler;}
+
+  private:
+    Scheduler *scheduler;
+    receivedCallback_t received;
+    newConnectionCallback_t newconnection;
+    changedConnectionsCallback_t changedconnections;
+    nodeTimeAdjustedCallback_t timeadjusted;
+};
+
+#endif
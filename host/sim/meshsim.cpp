@@ -0,0 +1,432 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+// Dependancies
+#include <chrono>
+#include "meshsim.h"
+
+// The markers of the state of the library and the sketch, see statebegin.cpp and stateend.cpp
+extern "C" char fyrstate_data_begin[], fyrstate_data_end[], fyrstate_bss_begin[], fyrstate_bss_end[];
+
+// The mesh object of the library, its scheduler runs the tasks of the active node
+extern painlessMesh mesh;
+
+// The state of the library before any node has run, every node starts from a copy of it
+static std::vector<char> PRISTINESTATE;
+
+
+// A function that decodes the message type from the first characters of a base64 encoded frame.
+static uint8_t frametype(const std::string &payload)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    if (payload.size() < 4) {return 0;}
+
+    uint32_t group = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        const char *at = strchr(alphabet, payload[i]);
+        group = (group << 6) | (at != NULL && *at != '\0' ? at - alphabet : 0);
+    }
+    // The second byte of the frame holds the type
+    return (group >> 8) & 0xFF;
+}
+
+
+SimNode::SimNode(MeshSimulator &simulator, uint32_t index, uint32_t nodeid, bool control, size_t statesize)
+    : simulator(simulator), index(index), control(control), booted(false), boottime(0), wake(0),
+      state(PRISTINESTATE), changedconnections(false), txlevel(0), txupdated(0), txbytes(0),
+      txblockedbytes(0), txblockedmicros(0), rxnext(0), rxoverflow(0), loops(0), loopnanos(0),
+      loopmaxnanos(0), stallmicros(0)
+{
+    this->nodeid = nodeid;
+    memset(&heapaccount, 0, sizeof(heapaccount));
+    heap = &heapaccount;
+    temperature = 24.0 + (index % 7) * 0.5;
+    humidity = 45.0 + (index % 11);
+    analogvalue = 300 + (index % 13) * 5;
+}
+
+uint64_t SimNode::hostmicros()
+{
+    return simulator.clock;
+}
+
+// Drains the transmit FIFO at the baud rate since it was last updated.
+void SimNode::updatetx()
+{
+    uint64_t elapsed = simulator.clock - txupdated;
+    txupdated = simulator.clock;
+    txlevel -= elapsed * (serialbaud / 10.0) / 1000000.0;
+    if (txlevel < 0) {txlevel = 0;}
+}
+
+size_t SimNode::serialwrite(const uint8_t *buffer, size_t size)
+{
+    HostHeapExempt exempt;
+    updatetx();
+
+    // Bytes that do not fit into the FIFO block the loop until they have been sent
+    double space = MESHSIM_TXFIFO - txlevel;
+    if (size > space) {
+        uint64_t blocked = size - (uint64_t)space;
+        txblockedbytes += blocked;
+        uint64_t micros = serialbaud > 0 ? blocked * 10000000ULL / serialbaud : 0;
+        txblockedmicros += micros;
+        stallmicros += micros;
+        txlevel = MESHSIM_TXFIFO;
+    } else {
+        txlevel += size;
+    }
+    txbytes += size;
+
+    // Collect the printed lines
+    for (size_t i = 0; i < size; i++) {
+        char character = buffer[i];
+        if (character == '\r') {continue;}
+        if (character == '\n') {logs.push_back(outputline); outputline.clear(); continue;}
+        outputline.push_back(character);
+    }
+    return size;
+}
+
+int SimNode::serialavailableforwrite()
+{
+    updatetx();
+    return MESHSIM_TXFIFO - (int)ceil(txlevel);
+}
+
+// Moves the bytes that have arrived by now into the receive buffer, dropping those that do not fit.
+void SimNode::pumprx()
+{
+    HostHeapExempt exempt;
+    while (!rxpending.empty() && rxpending.front().first <= simulator.clock) {
+        if (rxbuffer.size() < MESHSIM_RXBUFFER) {rxbuffer.push_back(rxpending.front().second);} else {rxoverflow++;}
+        rxpending.pop_front();
+    }
+}
+
+int SimNode::serialavailable()
+{
+    pumprx();
+    return rxbuffer.size();
+}
+
+int SimNode::serialread()
+{
+    pumprx();
+    if (rxbuffer.empty()) {return -1;}
+    HostHeapExempt exempt;
+    uint8_t character = rxbuffer.front();
+    rxbuffer.pop_front();
+    return character;
+}
+
+int SimNode::serialpeek()
+{
+    pumprx();
+    return rxbuffer.empty() ? -1 : (uint8_t)rxbuffer.front();
+}
+
+bool SimNode::meshsend(uint32_t destination, bool broadcast, const char *payload, size_t length)
+{
+    HostHeapExempt exempt;
+    std::shared_ptr<const std::string> message = std::make_shared<const std::string>(payload, length);
+
+    MeshSimTraffic &traffic = simulator.traffic;
+    traffic.frames++;
+    traffic.bytes += length;
+    traffic.types[frametype(*message) % MESHSIM_TYPES]++;
+    if (simulator.ontransmit) {simulator.ontransmit(*this, destination, broadcast, *message);}
+
+    if (broadcast) {
+        for (auto &node : simulator.nodes) {
+            if (node.get() != this && node->booted) {simulator.deliver(*this, *node, message);}
+        }
+        return true;
+    }
+
+    SimNode *target = simulator.find(destination);
+    if (target == NULL || !target->booted) {return false;}
+    simulator.deliver(*this, *target, message);
+    return true;
+}
+
+void SimNode::meshnodes(std::vector<uint32_t> &nodes)
+{
+    nodes.clear();
+    for (auto &node : simulator.nodes) {
+        if (node.get() != this && node->booted) {nodes.push_back(node->nodeid);}
+    }
+}
+
+bool SimNode::meshconnected(uint32_t node)
+{
+    SimNode *target = simulator.find(node);
+    return target != NULL && target != this && target->booted;
+}
+
+// Delivers the connection events and the messages that have arrived by now to the library.
+void SimNode::meshupdate(painlessMesh &mesh)
+{
+    std::vector<uint32_t> connections;
+    {
+        HostHeapExempt exempt;
+        connections.swap(newconnections);
+    }
+    for (uint32_t node : connections) {mesh.hostnewconnection(node);}
+    if (changedconnections) {
+        changedconnections = false;
+        mesh.hostchangedconnections();
+    }
+
+    while (!inbox.empty() && inbox.top().time <= simulator.clock) {
+        std::shared_ptr<const std::string> payload;
+        uint32_t from;
+        {
+            HostHeapExempt exempt;
+            payload = inbox.top().payload;
+            from = inbox.top().from;
+            inbox.pop();
+        }
+        // The received String is allocated by the node like painlessMesh allocates it
+        String message(payload->c_str());
+        mesh.hostreceive(from, message);
+        HostHeapExempt exempt;
+        payload.reset();
+    }
+}
+
+std::vector<std::string> SimNode::findlogs(const char *logtype, size_t from) const
+{
+    std::string pattern = std::string("\"logdata\":{\"type\":\"") + logtype + "\"";
+    std::vector<std::string> found;
+    for (size_t i = from; i < logs.size(); i++) {
+        if (logs[i].find(pattern) != std::string::npos) {found.push_back(logs[i]);}
+    }
+    return found;
+}
+
+
+MeshSimulator::MeshSimulator(const MeshSimConfig &config)
+    : config(config), current(NULL), clock(0), sequence(0), random(config.seed)
+{
+    memset(&traffic, 0, sizeof(traffic));
+    datasize = fyrstate_data_end - fyrstate_data_begin;
+    bsssize = fyrstate_bss_end - fyrstate_bss_begin;
+
+    // Take the snapshot of the state before the first node runs
+    if (PRISTINESTATE.empty()) {
+        HostHeapExempt exempt;
+        PRISTINESTATE.resize(datasize + bsssize);
+        memcpy(PRISTINESTATE.data(), fyrstate_data_begin, datasize);
+        memcpy(PRISTINESTATE.data() + datasize, fyrstate_bss_begin, bsssize);
+    }
+}
+
+MeshSimulator::~MeshSimulator()
+{
+    // Put the pristine state back so that the globals of the library hold no pointers into the freed nodes
+    memcpy(fyrstate_data_begin, PRISTINESTATE.data(), datasize);
+    memcpy(fyrstate_bss_begin, PRISTINESTATE.data() + datasize, bsssize);
+    current = NULL;
+    release();
+}
+
+void MeshSimulator::start(const std::function<void(SimNode &)> &configure)
+{
+    HostHeapExempt exempt;
+    configurer = configure;
+
+    // The control node boots first and the sensor nodes boot in random order within the boot window
+    nodes.emplace_back(new SimNode(*this, 0, MESHSIM_CONTROLNODE, true, statesize()));
+    for (uint16_t i = 0; i < config.nodes; i++) {
+        nodes.emplace_back(new SimNode(*this, i + 1, MESHSIM_FIRSTNODE + i * 7919, false, statesize()));
+    }
+
+    std::uniform_int_distribution<uint32_t> bootdelay(0, config.bootspread > 0 ? config.bootspread * 1000 - 1 : 0);
+    for (auto &node : nodes) {
+        nodeids[node->nodeid] = node.get();
+        node->boottime = clock + (node->control ? 0 : 100000 + bootdelay(random));
+        schedule(*node, node->boottime);
+    }
+}
+
+SimNode *MeshSimulator::find(uint32_t nodeid)
+{
+    auto found = nodeids.find(nodeid);
+    return found != nodeids.end() ? found->second : NULL;
+}
+
+// Swaps the state of the active node out and the state of the given node in.
+void MeshSimulator::activate(SimNode *node)
+{
+    if (current != node) {
+        if (current != NULL) {
+            memcpy(current->state.data(), fyrstate_data_begin, datasize);
+            memcpy(current->state.data() + datasize, fyrstate_bss_begin, bsssize);
+        }
+        memcpy(fyrstate_data_begin, node->state.data(), datasize);
+        memcpy(fyrstate_bss_begin, node->state.data() + datasize, bsssize);
+        current = node;
+    }
+    HOSTPLATFORM = node;
+    HOSTHEAPACCOUNT = &node->heapaccount;
+}
+
+// Points the platform and heap account back to the defaults of the host while no node runs.
+void MeshSimulator::release()
+{
+    HOSTPLATFORM = &HOSTDEFAULTPLATFORM;
+    HOSTHEAPACCOUNT = &HOSTHEAP;
+}
+
+void MeshSimulator::within(SimNode &node, const std::function<void()> &function)
+{
+    activate(&node);
+    function();
+    release();
+}
+
+void MeshSimulator::boot(SimNode &node)
+{
+    activate(&node);
+    {
+        HostHeapExempt exempt;
+        // The control node gets the configuration of the controlnode example
+        if (node.control) {DHTTYP = 0; GASTYP = 0; FLMTYP = 0; PINGER = false;}
+        if (configurer) {configurer(node);}
+
+        if (node.control) {node.controlnode.reset(new FyrNodeControl());} else {node.sensornode.reset(new FyrNode());}
+    }
+    if (node.control) {node.controlnode->begin();} else {node.sensornode->begin();}
+    node.booted = true;
+
+    // Connect the node to the control node
+    if (!node.control) {
+        HostHeapExempt exempt;
+        node.newconnections.push_back(control().nodeid);
+        node.changedconnections = true;
+        if (control().booted) {
+            control().newconnections.push_back(node.nodeid);
+            control().changedconnections = true;
+            schedule(control(), clock);
+        }
+    }
+}
+
+void MeshSimulator::schedule(SimNode &node, uint64_t time)
+{
+    HostHeapExempt exempt;
+    if (node.wake == time && wakes.count(std::make_pair(time, node.index))) {return;}
+    wakes.erase(std::make_pair(node.wake, node.index));
+    node.wake = time;
+    wakes.insert(std::make_pair(time, node.index));
+}
+
+void MeshSimulator::deliver(SimNode &from, SimNode &to, const std::shared_ptr<const std::string> &payload)
+{
+    if (config.loss > 0 && std::uniform_real_distribution<double>(0, 1)(random) < config.loss) {
+        traffic.dropped++;
+        return;
+    }
+
+    uint64_t latency = std::uniform_int_distribution<uint32_t>(config.latencymin, config.latencymax)(random);
+    to.inbox.push(MeshSimMessage{clock + latency, sequence++, from.nodeid, payload});
+    traffic.deliveries++;
+    if (clock + latency < to.wake) {schedule(to, clock + latency);}
+}
+
+// Runs one loop of a node and schedules its next loop.
+void MeshSimulator::runnode(SimNode &node)
+{
+    if (!node.booted) {boot(node);}
+    activate(&node);
+    node.stallmicros = 0;
+
+    auto started = std::chrono::steady_clock::now();
+    if (node.control) {node.controlnode->update();} else {node.sensornode->update();}
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    node.loops++;
+    node.loopnanos += nanos;
+    if (nanos > node.loopmaxnanos) {node.loopmaxnanos = nanos;}
+
+    // Wake up for the next tick, the next due task or the next message, whichever comes first
+    uint64_t tick = node.control ? config.controltick : config.sensortick;
+    uint64_t next = clock + tick * 1000;
+    uint32_t due = mesh.hostscheduler() != NULL ? mesh.hostscheduler()->hostnextdue() : UINT32_MAX;
+    if (due != UINT32_MAX) {next = std::min(next, (clock / 1000 + std::max<uint32_t>(due, 1)) * 1000);}
+    if (!node.inbox.empty()) {next = std::min(next, node.inbox.top().time);}
+    if (!node.newconnections.empty() || node.changedconnections) {next = std::min(next, clock + 1000);}
+    // A loop that blocked on the Serial port starts late
+    next = std::max(next, clock + std::max<uint64_t>(node.stallmicros, 1));
+    schedule(node, next);
+}
+
+bool MeshSimulator::step(uint64_t limit)
+{
+    if (wakes.empty() || wakes.begin()->first > limit) {return false;}
+
+    std::pair<uint64_t, uint32_t> wake = *wakes.begin();
+    {
+        HostHeapExempt exempt;
+        wakes.erase(wakes.begin());
+    }
+    if (wake.first > clock) {clock = wake.first;}
+    runnode(*nodes[wake.second]);
+    return true;
+}
+
+void MeshSimulator::run(uint32_t milliseconds)
+{
+    uint64_t limit = clock + (uint64_t)milliseconds * 1000;
+    while (step(limit)) {}
+    clock = limit;
+    release();
+}
+
+bool MeshSimulator::rununtil(const std::function<bool()> &condition, uint32_t timeout)
+{
+    uint64_t limit = clock + (uint64_t)timeout * 1000;
+    while (true) {
+        release();
+        if (condition()) {return true;}
+        if (!step(limit)) {break;}
+    }
+    clock = limit;
+    release();
+    return condition();
+}
+
+void MeshSimulator::controllerline(const std::string &line)
+{
+    HostHeapExempt exempt;
+    SimNode &node = control();
+    uint64_t bytemicros = node.serialbaud > 0 ? 10000000ULL / node.serialbaud : 0;
+    std::string bytes = line + "\n";
+    for (char character : bytes) {
+        node.rxnext = std::max(node.rxnext, clock) + bytemicros;
+        node.rxpending.push_back(std::make_pair(node.rxnext, character));
+    }
+}
@@ -0,0 +1,221 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+An in-process simulator of a fyrnode mesh: one FyrNodeControl and any number of FyrNode instances
+running the real library on a virtual clock.
+
+The library keeps its state in globals, so every simulated node owns a copy of the .data and .bss
+sections of the library and the sketch (see statebegin.cpp and stateend.cpp). The simulator copies
+the state of a node into place before running it and copies it back afterwards. The state of every
+node starts from a snapshot taken before any node has run.
+
+Nodes run when a task of their scheduler is due, when a message or connection event reaches them,
+or at least once per loop tick. Messages are delivered after a random latency and can be dropped
+with a configurable probability. The Serial port of every node is modelled as the 128 byte transmit
+FIFO of the ESP8266 UART draining at the configured baud rate, and writes that do not fit are
+counted as blocked time of the loop.
+*/
+
+#pragma once
+
+#ifndef MESHSIM_H_INCLUDED
+#define MESHSIM_H_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Arduino.h"
+#include "painlessMesh.h"
+#include "fyrnode.h"
+#include "simsketch.h"
+
+// Mesh Simulator Configuration Values
+#define MESHSIM_TXFIFO 128
+#define MESHSIM_RXBUFFER 256
+#define MESHSIM_CONTROLNODE 3000000001UL
+#define MESHSIM_FIRSTNODE 3100000000UL
+#define MESHSIM_TYPES 32
+
+// A structure that holds the configuration of a simulated mesh.
+struct MeshSimConfig
+{
+    uint16_t nodes = 60;            // The number of sensor nodes
+    uint32_t latencymin = 2000;     // The minimum delivery latency of a message (us)
+    uint32_t latencymax = 8000;     // The maximum delivery latency of a message (us)
+    double loss = 0.0;              // The probability that a message is dropped
+    uint32_t seed = 1;              // The seed of the latency, loss and boot order
+    uint32_t bootspread = 2000;     // The sensor nodes boot within this window (ms)
+    uint32_t controltick = 1;       // The control node runs its loop at least this often (ms)
+    uint32_t sensortick = 50;       // The sensor nodes run their loop at least this often (ms)
+};
+
+// A structure that holds the traffic counters of a simulated mesh.
+struct MeshSimTraffic
+{
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t deliveries;
+    uint64_t dropped;
+    uint64_t types[MESHSIM_TYPES];
+};
+
+// A structure that holds a message in flight to a simulated node.
+struct MeshSimMessage
+{
+    uint64_t time;
+    uint64_t sequence;
+    uint32_t from;
+    std::shared_ptr<const std::string> payload;
+
+    bool operator>(const MeshSimMessage &other) const {return time != other.time ? time > other.time : sequence > other.sequence;}
+};
+
+class MeshSimulator;
+
+// A simulated node, it is the platform of the library while the node runs.
+class SimNode : public HostPlatform
+{
+  public:
+    SimNode(MeshSimulator &simulator, uint32_t index, uint32_t nodeid, bool control, size_t statesize);
+
+    uint64_t hostmicros() override;
+    size_t serialwrite(const uint8_t *buffer, size_t size) override;
+    int serialavailableforwrite() override;
+    int serialavailable() override;
+    int serialread() override;
+    int serialpeek() override;
+    bool meshsend(uint32_t destination, bool broadcast, const char *payload, size_t length) override;
+    void meshnodes(std::vector<uint32_t> &nodes) override;
+    bool meshconnected(uint32_t node) override;
+    void meshupdate(painlessMesh &mesh) override;
+
+    // Returns the meshlog lines of the given type printed by the node since the given line
+    std::vector<std::string> findlogs(const char *logtype, size_t from = 0) const;
+
+    MeshSimulator &simulator;
+    uint32_t index;
+    bool control;
+    bool booted;
+    uint64_t boottime;
+    uint64_t wake;
+    std::vector<char> state;
+    HostHeapAccount heapaccount;
+    std::unique_ptr<FyrNode> sensornode;
+    std::unique_ptr<FyrNodeControl> controlnode;
+
+    // Mesh events waiting for the next loop
+    std::priority_queue<MeshSimMessage, std::vector<MeshSimMessage>, std::greater<MeshSimMessage>> inbox;
+    std::vector<uint32_t> newconnections;
+    bool changedconnections;
+
+    // Serial port
+    std::string outputline;
+    std::vector<std::string> logs;
+    double txlevel;
+    uint64_t txupdated;
+    uint64_t txbytes;
+    uint64_t txblockedbytes;
+    uint64_t txblockedmicros;
+    std::deque<std::pair<uint64_t, char>> rxpending;
+    std::deque<char> rxbuffer;
+    uint64_t rxnext;
+    uint64_t rxoverflow;
+
+    // Loop statistics in host time
+    uint64_t loops;
+    uint64_t loopnanos;
+    uint64_t loopmaxnanos;
+    uint64_t stallmicros;
+
+  private:
+    void updatetx();
+    void pumprx();
+};
+
+// A simulated mesh of one control node and any number of sensor nodes.
+class MeshSimulator
+{
+  public:
+    explicit MeshSimulator(const MeshSimConfig &config);
+    ~MeshSimulator();
+
+    // Creates the nodes and schedules their boot. The configure function is called for every node
+    // while it is active before it begins, to change its sketch globals or sensor readings.
+    void start(const std::function<void(SimNode &)> &configure = nullptr);
+    // Runs the mesh for the given virtual time
+    void run(uint32_t milliseconds);
+    // Runs the mesh until the condition holds or the timeout passes. Returns false on timeout.
+    bool rununtil(const std::function<bool()> &condition, uint32_t timeout);
+    // Sends a line to the Serial port of the control node at its baud rate
+    void controllerline(const std::string &line);
+    // Runs a function while a node is active, to read or change the state of the library of that node
+    void within(SimNode &node, const std::function<void()> &function);
+
+    SimNode &control() {return *nodes[0];}
+    SimNode &node(size_t index) {return *nodes[index + 1];}
+    size_t nodecount() const {return nodes.size() - 1;}
+    SimNode *find(uint32_t nodeid);
+    uint64_t now() const {return clock;}
+    size_t statesize() const {return datasize + bsssize;}
+
+    MeshSimTraffic traffic;
+    void resettraffic() {memset(&traffic, 0, sizeof(traffic));}
+
+    // Called for every message a node sends, to record the traffic of the mesh
+    std::function<void(SimNode &from, uint32_t destination, bool broadcast, const std::string &payload)> ontransmit;
+
+  private:
+    friend class SimNode;
+
+    void activate(SimNode *node);
+    void release();
+    void boot(SimNode &node);
+    void runnode(SimNode &node);
+    void schedule(SimNode &node, uint64_t time);
+    bool step(uint64_t limit);
+    void deliver(SimNode &from, SimNode &to, const std::shared_ptr<const std::string> &payload);
+
+    MeshSimConfig config;
+    std::function<void(SimNode &)> configurer;
+    std::vector<std::unique_ptr<SimNode>> nodes;
+    std::unordered_map<uint32_t, SimNode *> nodeids;
+    std::set<std::pair<uint64_t, uint32_t>> wakes;
+    SimNode *current;
+    uint64_t clock;
+    uint64_t sequence;
+    std::mt19937 random;
+    size_t datasize;
+    size_t bsssize;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+The sketch of the simulated nodes, it defines the configuration globals of a sensor node like the
+dht11node example does. The simulator gives the control node the configuration of the controlnode example.
+*/
+
+// Dependancies
+#include "simsketch.h"
+
+String MESH_SSID = "fyrwatchsim";
+String MESH_PSWD = "fyrwatchsim";
+uint16_t MESH_PORT = 5555;
+int MESH_GROUP = 0;
+
+int DHTTYP = 11;
+int DHTPIN = 4;
+int GASTYP = 1;
+int GASPIN = A0;
+int FLMTYP = 1;
+int FLMPIN = 14;
+
+bool PINGER = false;
+int PINGERPIN = 5;
+
+uint32_t REPORTINTERVAL = 0;
+float TEMTHRESHOLD = 0;
+int GASTHRESHOLD = 0;
+
+uint32_t SERIALBAUD = 115200;
+int CONNECTLEDPIN = 16;
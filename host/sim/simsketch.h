@@ -0,0 +1,63 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+The sketch configuration of the simulated nodes. Every simulated node holds its own copy of these
+globals along with the state of the library, so they can be changed for a node while it is active.
+*/
+
+#pragma once
+
+#ifndef SIMSKETCH_H_INCLUDED
+#define SIMSKETCH_H_INCLUDED
+
+#include "Arduino.h"
+
+// Mesh AP Configuration Values
+extern String MESH_SSID;
+extern String MESH_PSWD;
+extern uint16_t MESH_PORT;
+extern int MESH_GROUP;
+// Node Sensor Hardware Configuration Values
+extern int DHTTYP;
+extern int DHTPIN;
+extern int GASTYP;
+extern int GASPIN;
+extern int FLMTYP;
+extern int FLMPIN;
+// Node Button Hardware Configuration Values
+extern bool PINGER;
+extern int PINGERPIN;
+// Node Sensor Reporting Configuration Values
+extern uint32_t REPORTINTERVAL;
+extern float TEMTHRESHOLD;
+extern int GASTHRESHOLD;
+// Node Serial Interface Configuration Value
+extern uint32_t SERIALBAUD;
+// Node Connection LED Configuration Value
+extern int CONNECTLEDPIN;
+
+#endif
@@ -0,0 +1,8 @@
+/*
+The first object of the simulated node state. Linked ahead of the library and the sketch so that
+these markers open the .data and .bss sections that hold their state.
+*/
+extern "C" {
+char fyrstate_data_begin[1] = {1};
+char fyrstate_bss_begin[1];
+}
@@ -0,0 +1,8 @@
+/*
+The last object of the simulated node state. Linked after the library and the sketch so that
+these markers close the .data and .bss sections that hold their state.
+*/
+extern "C" {
+char fyrstate_data_end[1] = {1};
+char fyrstate_bss_end[1];
+}
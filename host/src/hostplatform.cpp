@@ -0,0 +1,407 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+// Dependancies
+#include <chrono>
+#include <new>
+#include <stdarg.h>
+#include "Arduino.h"
+#include "painlessMesh.h"
+
+// Global Heap Accounts
+HostHeapAccount HOSTHEAP = {0, 0, 0, 0};
+HostHeapAccount *HOSTHEAPACCOUNT = &HOSTHEAP;
+
+// Global Host Platform
+HostPlatform HOSTDEFAULTPLATFORM;
+HostPlatform *HOSTPLATFORM = &HOSTDEFAULTPLATFORM;
+
+// Global Core Objects
+HardwareSerial Serial;
+EspClass ESP;
+
+
+/*
+The global new and delete operators. Every allocation carries a header with its size and the
+account it was charged to, so that it is released from the same account when it is deleted.
+Allocations made while HOSTHEAPACCOUNT is NULL are not accounted.
+*/
+struct HeapHeader
+{
+    size_t size;
+    HostHeapAccount *account;
+};
+
+static const size_t HEAPHEADERSIZE = (sizeof(HeapHeader) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+void *operator new(size_t size)
+{
+    char *block = (char *)malloc(size + HEAPHEADERSIZE);
+    if (block == NULL) {throw std::bad_alloc();}
+
+    HeapHeader *header = (HeapHeader *)block;
+    header->size = size;
+    header->account = HOSTHEAPACCOUNT;
+    if (header->account != NULL) {
+        header->account->live += size;
+        header->account->allocations++;
+        header->account->allocatedbytes += size;
+        if (header->account->live > header->account->peak) {header->account->peak = header->account->live;}
+    }
+    return block + HEAPHEADERSIZE;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    if (pointer == NULL) {return;}
+
+    char *block = (char *)pointer - HEAPHEADERSIZE;
+    HeapHeader *header = (HeapHeader *)block;
+    if (header->account != NULL) {header->account->live -= header->size;}
+    free(block);
+}
+
+void *operator new[](size_t size) {return operator new(size);}
+void operator delete[](void *pointer) noexcept {operator delete(pointer);}
+void operator delete(void *pointer, size_t size) noexcept {operator delete(pointer);}
+void operator delete[](void *pointer, size_t size) noexcept {operator delete(pointer);}
+
+HostHeapExempt::HostHeapExempt() : saved(HOSTHEAPACCOUNT) {HOSTHEAPACCOUNT = NULL;}
+HostHeapExempt::~HostHeapExempt() {HOSTHEAPACCOUNT = saved;}
+
+void resetheapaccount(HostHeapAccount &account)
+{
+    account.peak = account.live;
+    account.allocations = 0;
+    account.allocatedbytes = 0;
+}
+
+
+// The host clock, counted from the start of the process.
+static uint64_t hostclockmicros()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+HostPlatform::HostPlatform()
+    : nodeid(HOSTPLATFORM_NODEID), clockmicros(0), manualclock(false), randomstate(1), heapsize(HOSTPLATFORM_HEAPSIZE), heap(&HOSTHEAP),
+      serialbaud(0), serialtxspace(INT16_MAX), pinwrites(0), analogvalue(0), temperature(25.0), humidity(50.0)
+{
+    memset(pinmodes, 0, sizeof(pinmodes));
+    memset(pinlevels, 0, sizeof(pinlevels));
+}
+
+uint64_t HostPlatform::hostmicros()
+{
+    return manualclock ? clockmicros : hostclockmicros();
+}
+
+void HostPlatform::setmanualclock(uint64_t micros)
+{
+    manualclock = true;
+    clockmicros = micros;
+}
+
+void HostPlatform::advanceclock(uint64_t micros)
+{
+    clockmicros += micros;
+}
+
+uint32_t HostPlatform::freeheap()
+{
+    return heap->live < heapsize ? heapsize - heap->live : 0;
+}
+
+uint32_t HostPlatform::cyclecount()
+{
+    return (uint32_t)(hostmicros() * cpumhz());
+}
+
+// A xorshift generator, seeded by randomSeed() like the core seeds its generator.
+uint32_t HostPlatform::randomnumber()
+{
+    randomstate ^= randomstate << 13;
+    randomstate ^= randomstate >> 17;
+    randomstate ^= randomstate << 5;
+    return randomstate;
+}
+
+size_t HostPlatform::serialwrite(const uint8_t *buffer, size_t size)
+{
+    HostHeapExempt exempt;
+    serialoutput.append((const char *)buffer, size);
+    return size;
+}
+
+int HostPlatform::serialread()
+{
+    if (serialinput.empty()) {return -1;}
+    uint8_t character = serialinput.front();
+    serialinput.pop_front();
+    return character;
+}
+
+void HostPlatform::pinmode(uint8_t pin, uint8_t mode)
+{
+    if (pin >= HOSTPLATFORM_PINS) {return;}
+    pinmodes[pin] = mode;
+    // An input with a pull-up reads high until something pulls it low
+    if (mode == INPUT_PULLUP) {pinlevels[pin] = HIGH;}
+}
+
+void HostPlatform::digitalwrite(uint8_t pin, uint8_t level)
+{
+    if (pin >= HOSTPLATFORM_PINS) {return;}
+    pinlevels[pin] = level;
+    pinwrites++;
+}
+
+bool HostPlatform::meshsend(uint32_t destination, bool broadcast, const char *payload, size_t length)
+{
+    HostHeapExempt exempt;
+    sent.push_back(HostMessage{destination, broadcast, std::string(payload, length)});
+    return true;
+}
+
+bool HostPlatform::meshconnected(uint32_t node)
+{
+    for (uint32_t peer : peers) {
+        if (peer == node) {return true;}
+    }
+    return false;
+}
+
+// Delivers the queued received messages to the library.
+void HostPlatform::meshupdate(painlessMesh &mesh)
+{
+    while (!received.empty()) {
+        HostMessage message;
+        {
+            HostHeapExempt exempt;
+            message = received.front();
+            received.pop_front();
+        }
+        String payload(message.payload.c_str());
+        mesh.hostreceive(message.node, payload);
+    }
+}
+
+
+// Core Functions
+unsigned long millis() {return (unsigned long)(uint32_t)(HOSTPLATFORM->hostmicros() / 1000);}
+unsigned long micros() {return (unsigned long)(uint32_t)HOSTPLATFORM->hostmicros();}
+void delay(unsigned long milliseconds) {if (HOSTPLATFORM->manualclock) {HOSTPLATFORM->advanceclock(milliseconds * 1000);}}
+void yield() {}
+long random(long howbig) {return howbig > 0 ? HOSTPLATFORM->randomnumber() % howbig : 0;}
+long random(long howsmall, long howbig) {return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);}
+void randomSeed(unsigned long seed) {HOSTPLATFORM->randomseed(seed);}
+void pinMode(uint8_t pin, uint8_t mode) {HOSTPLATFORM->pinmode(pin, mode);}
+int digitalRead(uint8_t pin) {return HOSTPLATFORM->digitalread(pin);}
+void digitalWrite(uint8_t pin, uint8_t level) {HOSTPLATFORM->digitalwrite(pin, level);}
+int analogRead(uint8_t pin) {return HOSTPLATFORM->analogread(pin);}
+
+
+String::String(float value, unsigned char decimals)
+{
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    text = buffer;
+}
+
+String::String(double value, unsigned char decimals)
+{
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    text = buffer;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    while (size--) {written += write(*buffer++);}
+    return written;
+}
+
+size_t Print::print(double value, int decimals)
+{
+    return printformat("%.*f", decimals, value);
+}
+
+size_t Print::printformat(const char *format, ...)
+{
+    char buffer[48];
+    va_list arguments;
+    va_start(arguments, format);
+    int size = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    return size > 0 ? write((const uint8_t *)buffer, size) : 0;
+}
+
+size_t Stream::readBytes(char *buffer, size_t size)
+{
+    size_t count = 0;
+    while (count < size && available() > 0) {buffer[count++] = read();}
+    return count;
+}
+
+
+Task::Task(unsigned long interval, long iterations, void (*callback)(), Scheduler *scheduler, bool enable)
+    : interval(interval), delayvalue(interval), iterations(iterations), setiterations(iterations),
+      previous(0), runcounter(0), enabled(false), callback(callback), scheduler(scheduler)
+{
+    if (scheduler != NULL) {scheduler->addTask(*this);}
+    if (enable) {this->enable();}
+}
+
+bool Task::enable()
+{
+    runcounter = 0;
+    enabled = true;
+    previous = millis() - (delayvalue = interval);
+    return true;
+}
+
+bool Task::enableDelayed(unsigned long delay)
+{
+    enable();
+    this->delay(delay);
+    return true;
+}
+
+bool Task::disable()
+{
+    bool was = enabled;
+    enabled = false;
+    return was;
+}
+
+bool Task::restart()
+{
+    iterations = setiterations;
+    return enable();
+}
+
+bool Task::restartDelayed(unsigned long delay)
+{
+    iterations = setiterations;
+    return enableDelayed(delay);
+}
+
+void Task::delay(unsigned long delay)
+{
+    delayvalue = delay ? delay : interval;
+    previous = millis();
+}
+
+void Task::forceNextIteration()
+{
+    previous = millis() - (delayvalue = interval);
+}
+
+void Task::setInterval(unsigned long interval)
+{
+    this->interval = interval;
+    delay();
+}
+
+void Scheduler::addTask(Task &task)
+{
+    for (uint8_t i = 0; i < taskcount; i++) {
+        if (tasks[i] == &task) {return;}
+    }
+    if (taskcount >= SCHEDULER_MAXTASKS) {return;}
+    task.scheduler = this;
+    tasks[taskcount++] = &task;
+}
+
+void Scheduler::deleteTask(Task &task)
+{
+    for (uint8_t i = 0; i < taskcount; i++) {
+        if (tasks[i] != &task) {continue;}
+        for (uint8_t j = i + 1; j < taskcount; j++) {tasks[j - 1] = tasks[j];}
+        taskcount--;
+        return;
+    }
+}
+
+// Runs every task that is due once, in the order the tasks were added. Returns true if no task ran.
+bool Scheduler::execute()
+{
+    bool idle = true;
+    for (uint8_t i = 0; i < taskcount; i++) {
+        Task &task = *tasks[i];
+        if (!task.enabled) {continue;}
+        if (task.iterations == 0) {task.disable(); continue;}
+
+        unsigned long now = millis();
+        if (now - task.previous < task.delayvalue) {continue;}
+
+        if (task.iterations > 0) {task.iterations--;}
+        task.runcounter++;
+        task.previous += task.delayvalue;
+        task.delayvalue = task.interval;
+        if (task.callback != NULL) {task.callback(); idle = false;}
+    }
+    return idle;
+}
+
+uint32_t Scheduler::hostnextdue()
+{
+    uint32_t next = UINT32_MAX;
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < taskcount; i++) {
+        Task &task = *tasks[i];
+        if (!task.enabled) {continue;}
+        if (task.iterations == 0) {return 0;}
+
+        unsigned long elapsed = now - task.previous;
+        uint32_t due = elapsed >= task.delayvalue ? 0 : task.delayvalue - elapsed;
+        if (due < next) {next = due;}
+    }
+    return next;
+}
+
+
+void painlessMesh::update()
+{
+    HOSTPLATFORM->meshupdate(*this);
+    if (scheduler != NULL) {scheduler->execute();}
+}
+
+std::list<uint32_t> painlessMesh::getNodeList(bool includeSelf)
+{
+    std::vector<uint32_t> nodes;
+    {
+        HostHeapExempt exempt;
+        HOSTPLATFORM->meshnodes(nodes);
+    }
+
+    // The list is allocated by the library like the one painlessMesh returns
+    std::list<uint32_t> nodelist(nodes.begin(), nodes.end());
+    if (includeSelf) {nodelist.push_back(getNodeId());}
+    return nodelist;
+}
@@ -0,0 +1,106 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+A minimal test runner for the host tests. Tests are declared with HOSTTEST() and use CHECK() and
+CHECKEQUAL(), which report the failed condition and let the test continue. The runner returns a
+non-zero exit code if any check failed so that ctest reports the failure.
+*/
+
+#pragma once
+
+#ifndef HOSTTEST_H_INCLUDED
+#define HOSTTEST_H_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// A structure that holds a registered test.
+struct HostTest
+{
+    const char *name;
+    void (*function)();
+};
+
+inline std::vector<HostTest> &hosttests() {static std::vector<HostTest> tests; return tests;}
+inline int HOSTTESTFAILURES = 0;
+
+struct HostTestRegistrar
+{
+    HostTestRegistrar(const char *name, void (*function)()) {hosttests().push_back(HostTest{name, function});}
+};
+
+#define HOSTTEST(name) \
+    static void name(); \
+    static HostTestRegistrar name##registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            HOSTTESTFAILURES++; \
+        } \
+    } while (0)
+
+#define CHECKEQUAL(actual, expected) \
+    do { \
+        long long actualvalue = (long long)(actual), expectedvalue = (long long)(expected); \
+        if (actualvalue != expectedvalue) { \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #actual, #expected, actualvalue, expectedvalue); \
+            HOSTTESTFAILURES++; \
+        } \
+    } while (0)
+
+// A function that runs every registered test, or the tests named on the command line.
+inline int runhosttests(int argc, char **argv)
+{
+    for (const HostTest &test : hosttests()) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) {selected |= std::string(argv[i]) == test.name;}
+        if (!selected) {continue;}
+
+        int failures = HOSTTESTFAILURES;
+        test.function();
+        printf("%s %s\n", HOSTTESTFAILURES == failures ? "PASS" : "FAIL", test.name);
+    }
+    return HOSTTESTFAILURES == 0 ? 0 : 1;
+}
+
+// A function that reads the number value of a key from a line of JSON text. Returns -1 if the key is missing.
+inline long long jsonnumber(const std::string &line, const char *key)
+{
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t at = line.find(pattern);
+    if (at == std::string::npos) {return -1;}
+    return atoll(line.c_str() + at + pattern.size());
+}
+
+#define HOSTTEST_MAIN() int main(int argc, char **argv) {return runhosttests(argc, argv);}
+
+#endif
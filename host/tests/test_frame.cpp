@@ -0,0 +1,333 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+Tests of the binary mesh message format. The library is compiled into this test so that its
+internal MeshFrame class can be exercised directly. Every test round-trips frames through their
+base64 wire representation, and the comparison with the JSON message format used before the binary
+format prints a 'framebench' line of JSON with the sizes and the encode and decode times.
+*/
+
+// Dependancies
+#include <chrono>
+#include "hosttest.h"
+#include "fyrnode.cpp"
+
+// A ping ID that is one character longer than the longest ping ID a frame can hold
+#define TESTPING_TOOLONG "controlping-0123456789abcdefghij"
+
+// A function that fills a frame with the fields of a typical 'sensordata' message.
+static void fillsensorframe(MeshFrame &frame, const char *ping)
+{
+    frame.begin(IMC_SENSORDATA, IMC_UNICAST, 3100007919u, 3000000001u, ping);
+    frame.addf32(IMC_SENSOR_HUM, 54.5f);
+    frame.addf32(IMC_SENSOR_TEM, 27.25f);
+    frame.addu16(IMC_SENSOR_GAS, 412);
+    frame.addu8(IMC_SENSOR_FLM, 1);
+    frame.addu32(IMC_SENSOR_AGE, 1250);
+    frame.addu32(IMC_FIELD_CONFIGHASH, 0xA5C3F00Du);
+}
+
+// A function that encodes a frame and decodes it into another frame. Returns false if either step fails.
+static bool roundtrip(MeshFrame &frame, MeshFrame &decoded)
+{
+    char encoded[IMC_MAXENCODED + 1];
+    size_t length = frame.encode(encoded, sizeof(encoded));
+    return length > 0 && decoded.decode(encoded, length);
+}
+
+// A function that drains the log sink and returns the Serial output of the default platform.
+static std::string drainedoutput()
+{
+    for (int i = 0; i < 8; i++) {LOGSINK.drain(Serial);}
+    return HOSTDEFAULTPLATFORM.serialoutput;
+}
+
+HOSTTEST(frame_roundtrip_keeps_header_and_fields)
+{
+    MeshFrame frame, decoded;
+    fillsensorframe(frame, "controlping123456");
+    CHECK(roundtrip(frame, decoded));
+
+    CHECKEQUAL(decoded.type, IMC_SENSORDATA);
+    CHECKEQUAL(decoded.reach, IMC_UNICAST);
+    CHECKEQUAL(decoded.origin, 3100007919u);
+    CHECKEQUAL(decoded.destination, 3000000001u);
+    CHECK(strcmp(decoded.ping, "controlping123456") == 0);
+
+    MeshField field;
+    CHECK(decoded.findfield(IMC_SENSOR_TEM, field));
+    CHECK(field.kind == IMC_KIND_F32 && field.floatvalue == 27.25f);
+    CHECKEQUAL(decoded.getuint(IMC_SENSOR_GAS, 0), 412);
+    CHECKEQUAL(decoded.getuint(IMC_SENSOR_FLM, 0), 1);
+    CHECKEQUAL(decoded.getuint(IMC_FIELD_CONFIGHASH, 0), 0xA5C3F00Du);
+    CHECKEQUAL(decoded.hashfields(), frame.hashfields());
+}
+
+HOSTTEST(frame_fields_leave_out_the_sequence)
+{
+    // The same fields sent with and without a reliable sequence number
+    MeshFrame frame, sequenced;
+    fillsensorframe(frame, "configsync");
+    fillsensorframe(sequenced, "configsync");
+    sequenced.addu16(IMC_FIELD_SEQUENCE, 4711);
+
+    CHECKEQUAL(sequenced.hashfields(), frame.hashfields());
+    uint8_t fields[IMC_MAXFRAME], sequencedfields[IMC_MAXFRAME];
+    uint16_t count = frame.copyfields(fields, sizeof(fields));
+    CHECK(count > 0);
+    CHECKEQUAL(sequenced.copyfields(sequencedfields, sizeof(sequencedfields)), count);
+    CHECK(memcmp(fields, sequencedfields, count) == 0);
+    CHECKEQUAL(frame.copyfields(fields, count - 1), 0);
+}
+
+HOSTTEST(frame_roundtrip_keeps_bytes_fields)
+{
+    MeshFrame frame, decoded;
+    uint8_t data[40];
+    for (uint8_t i = 0; i < sizeof(data); i++) {data[i] = i * 7;}
+    frame.begin(IMC_HISTORYDATA, IMC_UNICAST, 1, 2, NULL);
+    frame.addbytes(3, data, sizeof(data));
+    frame.addu8(4, 9);
+    CHECK(roundtrip(frame, decoded));
+
+    MeshField field;
+    CHECK(decoded.findfield(3, field));
+    CHECKEQUAL(field.uintvalue, sizeof(data));
+    CHECK(field.data != NULL && memcmp(field.data, data, sizeof(data)) == 0);
+    CHECKEQUAL(decoded.getuint(4, 0), 9);
+    CHECKEQUAL(strlen(decoded.ping), 0);
+}
+
+HOSTTEST(frame_rejects_truncated_input)
+{
+    MeshFrame frame, decoded;
+    fillsensorframe(frame, "ping");
+    char encoded[IMC_MAXENCODED + 1];
+    size_t length = frame.encode(encoded, sizeof(encoded));
+    CHECK(length > 0);
+
+    // Every truncation that cuts into the header, the ping or a field value must be rejected.
+    // Truncations that end exactly on a field boundary are valid frames with fewer fields,
+    // whose fields must all hold the values of the original frame.
+    size_t accepted = 0;
+    for (size_t cut = 0; cut < length; cut++) {
+        if (!decoded.decode(encoded, cut)) {continue;}
+        accepted++;
+        MeshField field, original; uint16_t cursor = 0;
+        while (decoded.nextfield(cursor, field)) {
+            CHECK(frame.findfield(field.id, original) && original.uintvalue == field.uintvalue);
+        }
+    }
+    CHECK(accepted < length / 4);
+    CHECK(!decoded.decode(encoded, IMC_HEADERSIZE));
+    CHECK(!decoded.decode("", 0));
+}
+
+HOSTTEST(frame_rejects_invalid_characters_and_oversized_input)
+{
+    MeshFrame decoded;
+    CHECK(!decoded.decode("AQQB*wAAAAAAAAAA", 16));
+    CHECK(!decoded.decode("{\"type\":\"message\"}", 18));
+
+    std::string oversized(IMC_MAXENCODED + 8, 'A');
+    CHECK(!decoded.decode(oversized.c_str(), oversized.size()));
+}
+
+HOSTTEST(frame_skips_unknown_field_ids)
+{
+    MeshFrame frame, decoded;
+    frame.begin(IMC_MESHCOMMAND, IMC_UNICAST, 1, 2, "p");
+    frame.addu32(27, 0xDEADBEEF);
+    frame.addbytes(26, (const uint8_t *)"future", 6);
+    frame.addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READSENSORS);
+    CHECK(roundtrip(frame, decoded));
+
+    // A field with a known kind and an unknown ID is skipped, the known fields after it are read
+    CHECKEQUAL(decoded.getuint(IMC_FIELD_COMMAND, 0), IMC_COMMAND_READSENSORS);
+    MeshField field; uint16_t cursor = 0; int count = 0;
+    while (decoded.nextfield(cursor, field)) {count++;}
+    CHECKEQUAL(count, 3);
+}
+
+HOSTTEST(frame_rejects_unknown_field_kinds)
+{
+    // A field kind that is not known has no known size, so the rest of the frame cannot be parsed
+    MeshFrame frame, decoded;
+    frame.begin(IMC_MESHCOMMAND, IMC_UNICAST, 1, 2, "p");
+    uint8_t unknownkind[] = {(7 << 5) | 3, 0x01, 0x02};
+    frame.addfields(unknownkind, sizeof(unknownkind));
+    CHECK(!roundtrip(frame, decoded));
+}
+
+HOSTTEST(frame_rejects_other_wire_versions)
+{
+    MeshFrame frame, decoded;
+    fillsensorframe(frame, "ping");
+    char encoded[IMC_MAXENCODED + 1];
+    size_t length = frame.encode(encoded, sizeof(encoded));
+    CHECK(decoded.decode(encoded, length));
+
+    // The wire version is the first byte, held in the high bits of the first two characters
+    for (uint8_t version : {0, IMC_WIREVERSION + 1, 0x7B}) {
+        char changed[IMC_MAXENCODED + 1];
+        memcpy(changed, encoded, length + 1);
+        uint8_t second = base64value(changed[1]);
+        changed[0] = BASE64CHARS[version >> 2];
+        changed[1] = BASE64CHARS[((version & 0x03) << 4) | (second & 0x0F)];
+        CHECK(!decoded.decode(changed, length));
+
+        uint8_t type, reach; uint32_t destination;
+        CHECK(!peekframeheader(changed, length, type, reach, destination));
+    }
+}
+
+HOSTTEST(frame_rejects_overlong_ping)
+{
+    HOSTDEFAULTPLATFORM.serialoutput.clear();
+    MeshFrame frame;
+    CHECKEQUAL(strlen(TESTPING_TOOLONG), IMC_MAXPING + 1);
+
+    // The longest ping ID is accepted as is
+    std::string longest(IMC_MAXPING, 'p');
+    CHECK(frame.begin(IMC_MESHCOMMAND, IMC_UNICAST, 1, 2, longest.c_str()));
+    MeshFrame decoded;
+    CHECK(roundtrip(frame, decoded));
+    CHECK(longest == decoded.ping);
+
+    // A longer ping ID is rejected and the frame cannot be encoded
+    CHECK(!frame.begin(IMC_MESHCOMMAND, IMC_UNICAST, 1, 2, TESTPING_TOOLONG));
+    frame.addu8(IMC_FIELD_COMMAND, IMC_COMMAND_READSENSORS);
+    char encoded[IMC_MAXENCODED + 1];
+    CHECKEQUAL(frame.encode(encoded, sizeof(encoded)), 0);
+
+    std::string output = drainedoutput();
+    CHECK(output.find("\"type\":\"pingrejected\"") != std::string::npos);
+    CHECK(output.find(TESTPING_TOOLONG) != std::string::npos);
+}
+
+HOSTTEST(command_with_overlong_ping_is_not_sent)
+{
+    HOSTDEFAULTPLATFORM.serialoutput.clear();
+    HOSTDEFAULTPLATFORM.sent.clear();
+
+    CHECK(!sendcommand_readsensors(0, TESTPING_TOOLONG));
+    sendcommand_readconfig(3100007919u, TESTPING_TOOLONG);
+    CHECKEQUAL(HOSTDEFAULTPLATFORM.sent.size(), 0);
+
+    // A valid ping is still sent
+    CHECK(sendcommand_readsensors(3100007919u, "controlping123456"));
+    CHECKEQUAL(HOSTDEFAULTPLATFORM.sent.size(), 1);
+
+    std::string output = drainedoutput();
+    size_t first = output.find("\"type\":\"pingrejected\"");
+    CHECK(first != std::string::npos);
+    CHECK(first != std::string::npos && output.find("\"type\":\"pingrejected\"", first + 1) != std::string::npos);
+}
+
+HOSTTEST(unicast_without_destination_is_not_tracked)
+{
+    HOSTDEFAULTPLATFORM.sent.clear();
+    memset(RELIABLESLOTS, 0, sizeof(RELIABLESLOTS));
+
+    // A reply sent before the control node is known has no destination and is sent once without a sequence
+    PooledFrame reply;
+    reply->begin(IMC_SENSORDATA, IMC_UNICAST, 3100007919u, 0, "controlping123456");
+    sendmeshmessage(*reply);
+    CHECKEQUAL(HOSTDEFAULTPLATFORM.sent.size(), 1);
+    MeshFrame decoded;
+    MeshField field;
+    const std::string &payload = HOSTDEFAULTPLATFORM.sent.back().payload;
+    CHECK(decoded.decode(payload.c_str(), payload.size()));
+    CHECK(!decoded.findfield(IMC_FIELD_SEQUENCE, field));
+    for (const ReliableSlot &slot : RELIABLESLOTS) {CHECK(!slot.active);}
+
+    // The same reply to a known control node is tracked until it is acked
+    reply->begin(IMC_SENSORDATA, IMC_UNICAST, 3100007919u, 3000000001u, "controlping123456");
+    sendmeshmessage(*reply);
+    CHECK(RELIABLESLOTS[0].active && RELIABLESLOTS[0].destination == 3000000001u);
+    memset(RELIABLESLOTS, 0, sizeof(RELIABLESLOTS));
+}
+
+
+// A function that builds a 'sensordata' message in the JSON format that was sent before the binary format.
+static void fillsensorjson(JsonDocument &message, const char *ping)
+{
+    message["type"] = "message";
+    message["origin"] = 3100007919u;
+    message["reach"]["type"] = "unicast";
+    message["reach"]["destination"] = 3000000001u;
+    message["data"]["ping"] = ping;
+    message["data"]["type"] = "sensordata";
+    message["data"]["sensors"]["HUM"] = 54.5f;
+    message["data"]["sensors"]["TEM"] = 27.25f;
+    message["data"]["sensors"]["GAS"] = 412;
+    message["data"]["sensors"]["FLM"] = 1;
+}
+
+HOSTTEST(frame_is_smaller_and_faster_than_json)
+{
+    const int iterations = 20000;
+    const char *ping = "controlping123456";
+    volatile uint32_t sink = 0;
+
+    // Binary format: build, encode and decode the frame, then read every sensor value
+    MeshFrame frame, decoded;
+    char encoded[IMC_MAXENCODED + 1];
+    size_t binarysize = 0;
+    auto binarystart = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fillsensorframe(frame, ping);
+        binarysize = frame.encode(encoded, sizeof(encoded));
+        decoded.decode(encoded, binarysize);
+        MeshField field; uint16_t cursor = 0;
+        while (decoded.nextfield(cursor, field)) {sink += field.uintvalue;}
+    }
+    double binaryns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - binarystart).count() / iterations;
+
+    // JSON format: build and serialize the document, then deserialize it and read every sensor value
+    DynamicJsonDocument message(JSON_OBJECT_SIZE(64)), received(JSON_OBJECT_SIZE(32));
+    String payload;
+    size_t jsonsize = 0;
+    auto jsonstart = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        message.clear();
+        fillsensorjson(message, ping);
+        payload = "";
+        serializeJson(message, payload);
+        jsonsize = payload.length();
+        deserializeJson(received, payload);
+        JsonVariant sensors = received["data"]["sensors"];
+        for (const char *key : {"HUM", "TEM", "GAS", "FLM"}) {sink += sensors[key].as<uint32_t>();}
+    }
+    double jsonns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - jsonstart).count() / iterations;
+
+    printf("{\"framebench\":{\"binarybytes\":%zu,\"jsonbytes\":%zu,\"binaryns\":%.0f,\"jsonns\":%.0f}}\n", binarysize, jsonsize, binaryns, jsonns);
+    CHECK(binarysize > 0 && binarysize * 2 < jsonsize);
+    CHECK(sink != 0);
+}
+
+HOSTTEST_MAIN()
@@ -0,0 +1,125 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+Heap tests of the library on a simulated mesh. The tests replay thousands of messages and control
+commands through every node and check that the heap high-water mark of each node stays flat once
+the first cycle has warmed up the preallocated pools and buffers.
+*/
+
+// Dependancies
+#include <algorithm>
+#include "hosttest.h"
+#include "meshsim.h"
+
+// The heap low water mark recorded by the library of the active node
+extern uint32_t HEAPLOWWATER;
+
+/*
+The number of bytes the peak of a node may move between cycles. The String that painlessMesh copies
+for every sent message follows the length of the message, and the varint packed counters of a
+nodemetrics message grow by a byte whenever a counter crosses 128 or 16384.
+*/
+#define HEAPREPLAY_SLACK 16
+
+// The control commands replayed in every cycle, the node commands are sent to the first sensor node
+const char *const HEAPCYCLECOMMANDS[] = {
+    "readsensors-mesh", "readconfig-mesh", "readsensors-node", "readconfig-node", "readhistory-node",
+    "readprofile-node", "readtraffic-node", "readnodelist-control", "readmemory-control",
+    "readstats-control", "readmetrics-control", "readprofile-control", "readtraffic-control"
+};
+
+// A function that sends every command of the cycle to the control node and lets the mesh handle the replies.
+static void runheapcycle(MeshSimulator &sim, int cycle)
+{
+    char line[192];
+    for (const char *command : HEAPCYCLECOMMANDS) {
+        snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"%s\",\"node\":%u,\"ping\":\"heap%03d\"}",
+                 command, sim.node(0).nodeid, cycle);
+        sim.controllerline(line);
+        sim.run(500);
+    }
+    // Let the batch deadlines and the pending pings of the cycle expire
+    sim.run(6000);
+}
+
+// A function that returns the heap low water mark of a node.
+static uint32_t heaplowwater(MeshSimulator &sim, SimNode &node)
+{
+    uint32_t lowwater = 0;
+    sim.within(node, [&]() {lowwater = HEAPLOWWATER;});
+    return lowwater;
+}
+
+HOSTTEST(heap_peak_is_flat_across_message_cycles)
+{
+    MeshSimConfig config;
+    config.nodes = 20;
+    MeshSimulator sim(config);
+    sim.start();
+    bool handshaken = sim.rununtil([&]() {
+        for (size_t i = 0; i < sim.nodecount(); i++) {
+            if (sim.node(i).findlogs("handshakecomplete").empty()) {return false;}
+        }
+        return true;
+    }, 30000);
+    CHECK(handshaken);
+
+    // Warm up the pools, buffers and caches of every node with the first cycles
+    for (int cycle = 0; cycle < 2; cycle++) {runheapcycle(sim, cycle);}
+
+    std::vector<size_t> warmpeak, warmlive;
+    std::vector<uint32_t> warmlowwater;
+    for (size_t i = 0; i <= sim.nodecount(); i++) {
+        SimNode &node = (i == 0) ? sim.control() : sim.node(i - 1);
+        warmpeak.push_back(node.heapaccount.peak);
+        warmlive.push_back(node.heapaccount.live);
+        warmlowwater.push_back(heaplowwater(sim, node));
+        resetheapaccount(node.heapaccount);
+    }
+
+    // Replay the cycle many times. The live heap of every node must not move and its peak and low
+    // water mark may only move by the length of the messages it sends.
+    sim.resettraffic();
+    size_t drift = 0;
+    for (int cycle = 2; cycle < 32; cycle++) {
+        runheapcycle(sim, cycle);
+        for (size_t i = 0; i <= sim.nodecount(); i++) {
+            SimNode &node = (i == 0) ? sim.control() : sim.node(i - 1);
+            if (node.heapaccount.peak > warmpeak[i]) {drift = std::max(drift, node.heapaccount.peak - warmpeak[i]);}
+            CHECK(node.heapaccount.peak <= warmpeak[i] + HEAPREPLAY_SLACK);
+            CHECKEQUAL(node.heapaccount.live, warmlive[i]);
+            CHECK(heaplowwater(sim, node) + HEAPREPLAY_SLACK >= warmlowwater[i]);
+            resetheapaccount(node.heapaccount);
+        }
+    }
+
+    printf("{\"heapreplay\":{\"nodes\":%zu,\"cycles\":30,\"deliveries\":%llu,\"controlpeak\":%zu,\"peakdrift\":%zu}}\n",
+           sim.nodecount(), (unsigned long long)sim.traffic.deliveries, warmpeak[0], drift);
+    CHECK(sim.traffic.deliveries > 2000);
+}
+
+HOSTTEST_MAIN()
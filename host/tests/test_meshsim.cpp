@@ -0,0 +1,490 @@
+/*
+===========================================================================
+MIT License
+
+Copyright (c) 2021 Manish Meganathan, Mariyam A.Ghani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===========================================================================
+*/
+
+/*
+Tests of the control node on a simulated mesh. Every sweep prints a 'sweep' line of JSON with its
+latency and message counts so that runs can be compared.
+*/
+
+// Dependancies
+#include <set>
+#include "hosttest.h"
+#include "meshsim.h"
+
+// The coalesced connection changes of a sensor node that have not been sent to the control node
+extern uint16_t NODENEWCONNECTIONS;
+extern uint16_t NODECHANGEDCONNECTIONS;
+
+// The node registry and the config cache of the control node
+extern uint16_t NODEREGISTRYCOUNT;
+extern uint8_t CONFIGCACHECOUNT;
+bool isconfigcached(uint32_t node);
+
+// The handshake state of a sensor node
+extern uint32_t MESHCONTROLNODE;
+extern Task handshaketask;
+
+// The history ring buffer of a sensor node and the messages the reliable unicast layer could not track
+extern uint16_t HISTORYCOUNT;
+extern uint32_t RELIABLEUNTRACKED;
+
+// The command sender that the PINGER button of a sensor node uses
+bool sendcommand_readsensors(uint32_t node, const char *pingid);
+
+// The message types of the wire format counted in the traffic of the simulator
+#define MESHSIM_MESHCOMMAND 1
+#define MESHSIM_SENSORDATA 4
+#define MESHSIM_ACK 8
+
+// A structure that holds the result of a readsensors-mesh sweep.
+struct SweepResult
+{
+    bool logged;
+    long long expected;
+    long long received;
+    uint64_t latency;
+    uint64_t blockedbytes;
+    MeshSimTraffic traffic;
+};
+
+// A function that runs the mesh until every sensor node has completed its handshake and the control node has settled.
+static bool waitforhandshakes(MeshSimulator &sim, uint32_t timeout)
+{
+    bool done = sim.rununtil([&]() {
+        for (size_t i = 0; i < sim.nodecount(); i++) {
+            if (sim.node(i).findlogs("handshakecomplete").empty()) {return false;}
+        }
+        return true;
+    }, timeout);
+    // Let the mesh sync settle window of the control node pass
+    sim.run(3000);
+    return done;
+}
+
+// A function that sends a readsensors-mesh command to the control node and waits for its sensor batch.
+static SweepResult runsweep(MeshSimulator &sim, const char *ping)
+{
+    SweepResult result;
+    size_t from = sim.control().logs.size();
+    uint64_t started = sim.now();
+    uint64_t blocked = sim.control().txblockedbytes;
+    sim.resettraffic();
+
+    sim.controllerline(std::string("{\"type\":\"controlcommand\",\"command\":\"readsensors-mesh\",\"ping\":\"") + ping + "\"}");
+    result.logged = sim.rununtil([&]() {return !sim.control().findlogs("sensordata-batch", from).empty();}, 10000);
+    result.latency = sim.now() - started;
+    result.traffic = sim.traffic;
+    // Let the batch meshlog drain to the Serial port and count the bytes that blocked the loop
+    sim.run(2000);
+    result.blockedbytes = sim.control().txblockedbytes - blocked;
+
+    std::vector<std::string> batch = sim.control().findlogs("sensordata-batch", from);
+    result.expected = batch.empty() ? -1 : jsonnumber(batch[0], "expected");
+    result.received = batch.empty() ? -1 : jsonnumber(batch[0], "received");
+
+    printf("{\"sweep\":\"%s\",\"nodes\":%zu,\"expected\":%lld,\"received\":%lld,\"latencyms\":%.1f,"
+           "\"blocked\":%llu,\"frames\":%llu,\"bytes\":%llu,\"deliveries\":%llu,\"dropped\":%llu,\"meshcommand\":%llu,\"sensordata\":%llu,\"ack\":%llu}\n",
+           ping, sim.nodecount(), result.expected, result.received, result.latency / 1000.0, (unsigned long long)result.blockedbytes,
+           (unsigned long long)result.traffic.frames, (unsigned long long)result.traffic.bytes,
+           (unsigned long long)result.traffic.deliveries, (unsigned long long)result.traffic.dropped,
+           (unsigned long long)result.traffic.types[MESHSIM_MESHCOMMAND], (unsigned long long)result.traffic.types[MESHSIM_SENSORDATA],
+           (unsigned long long)result.traffic.types[MESHSIM_ACK]);
+    return result;
+}
+
+
+HOSTTEST(sweep_collects_every_node)
+{
+    MeshSimConfig config;
+    config.nodes = 60;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    SweepResult sweep = runsweep(sim, "sweep60");
+    CHECK(sweep.logged);
+    CHECKEQUAL(sweep.expected, 60);
+    CHECKEQUAL(sweep.received, 60);
+    // The batch completes as soon as the last reply arrives, well ahead of its deadline
+    CHECK(sweep.latency < 1000000);
+    // One reply per node, each acknowledged by the reliable unicast layer
+    CHECKEQUAL(sweep.traffic.types[MESHSIM_SENSORDATA], 60);
+    CHECK(sweep.traffic.types[MESHSIM_ACK] >= 60);
+    // The batch meshlog is streamed as the Serial port drains and never blocks the loop
+    CHECKEQUAL(sweep.blockedbytes, 0);
+}
+
+HOSTTEST(sweep_completes_under_loss)
+{
+    MeshSimConfig config;
+    config.nodes = 60;
+    config.loss = 0.1;
+    config.seed = 7;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 60000));
+
+    // Nodes that missed the broadcast do not reply and are reported as missing at the deadline
+    SweepResult sweep = runsweep(sim, "sweeploss");
+    CHECK(sweep.logged);
+    CHECKEQUAL(sweep.expected, 60);
+    CHECK(sweep.received > 0 && sweep.received <= 60);
+    CHECK(sweep.traffic.dropped > 0);
+}
+
+HOSTTEST(hundreds_of_nodes_handshake)
+{
+    MeshSimConfig config;
+    config.nodes = 200;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 60000));
+
+    // The batch holds an entry for every node in the registry
+    SweepResult sweep = runsweep(sim, "sweep200");
+    CHECK(sweep.logged);
+    CHECKEQUAL(sweep.expected, 200);
+    CHECKEQUAL(sweep.received, 200);
+    CHECKEQUAL(sweep.traffic.types[MESHSIM_SENSORDATA], 200);
+    CHECKEQUAL(sweep.blockedbytes, 0);
+}
+
+HOSTTEST(late_replies_do_not_complete_a_batch)
+{
+    MeshSimConfig config;
+    config.nodes = 8;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // Start a batch for two nodes and send a third node a command with the same ping while they are paced
+    size_t from = sim.control().logs.size();
+    char line[192];
+    snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"readsensors-nodes\",\"nodes\":[%u,%u],\"rate\":5,\"ping\":\"latebatch\"}",
+             sim.node(0).nodeid, sim.node(1).nodeid);
+    sim.controllerline(line);
+    snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"readsensors-node\",\"node\":%u,\"ping\":\"latebatch\"}",
+             sim.node(2).nodeid);
+    sim.controllerline(line);
+    CHECK(sim.rununtil([&]() {return !sim.control().findlogs("sensordata-batch", from).empty();}, 10000));
+
+    // The batch waits for both expected nodes and carries the reading of the third node as a late reply
+    std::vector<std::string> batch = sim.control().findlogs("sensordata-batch", from);
+    CHECK(!batch.empty());
+    if (batch.empty()) {return;}
+    CHECKEQUAL(jsonnumber(batch[0], "expected"), 2);
+    CHECKEQUAL(jsonnumber(batch[0], "received"), 2);
+    CHECKEQUAL(jsonnumber(batch[0], "late"), 1);
+    CHECK(batch[0].find("\"missing\":[]") != std::string::npos);
+}
+
+HOSTTEST(readsensors_mesh_batches_only_sent_commands)
+{
+    MeshSimConfig config;
+    config.nodes = 4;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // A rejected ping ID sends no command and leaves no empty batch to be logged at the deadline
+    size_t from = sim.control().logs.size();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-mesh\",\"ping\":\"a-ping-id-that-is-longer-than-the-wire-format-allows\"}");
+    sim.run(5000);
+    CHECKEQUAL(sim.control().findlogs("pingrejected", from).size(), 1);
+    CHECK(sim.control().findlogs("sensordata-batch", from).empty());
+
+    // A generated ping ID is resolved once and shared by the batch and the replies
+    from = sim.control().logs.size();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-mesh\",\"ping\":\"control\"}");
+    CHECK(sim.rununtil([&]() {return !sim.control().findlogs("sensordata-batch", from).empty();}, 5000));
+    std::vector<std::string> batch = sim.control().findlogs("sensordata-batch", from);
+    CHECK(!batch.empty());
+    if (batch.empty()) {return;}
+    CHECK(batch[0].find("\"ping\":\"controlping") != std::string::npos);
+    CHECKEQUAL(jsonnumber(batch[0], "received"), sim.nodecount());
+}
+
+HOSTTEST(connection_changes_before_the_handshake_are_sent)
+{
+    MeshSimConfig config;
+    config.nodes = 8;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // The nodes connect before they know the control node, and send those changes once the handshake completes
+    size_t pending = 0;
+    for (size_t i = 0; i < sim.nodecount(); i++) {
+        sim.within(sim.node(i), [&]() {pending += NODENEWCONNECTIONS + NODECHANGEDCONNECTIONS;});
+    }
+    CHECKEQUAL(pending, 0);
+
+    long long reports = 0;
+    for (const std::string &meshsync : sim.control().findlogs("meshsync")) {reports += jsonnumber(meshsync, "reports");}
+    CHECK(reports >= (long long)sim.nodecount());
+}
+
+// A function that counts the meshlogs of a type logged by the control node since a position that contain a text.
+static size_t countlogs(MeshSimulator &sim, const char *logtype, size_t from, const char *text)
+{
+    size_t count = 0;
+    for (const std::string &log : sim.control().findlogs(logtype, from)) {
+        if (log.find(text) != std::string::npos) {count++;}
+    }
+    return count;
+}
+
+HOSTTEST(readconfig_mesh_answers_from_the_cache)
+{
+    // More nodes than the config cache has entries, which share their configs
+    MeshSimConfig config;
+    config.nodes = 80;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+    sim.run(2000);
+
+    // The cached configs answer every node without a meshcommand and at a pace that does not stall the Serial port
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readmemory-control\"}");
+    sim.run(1000);
+    size_t from = sim.control().logs.size();
+    long long stalls = jsonnumber(sim.control().findlogs("controlmemorydata", 0).back(), "LOGSTALLS");
+    sim.resettraffic();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readconfig-mesh\",\"ping\":\"cachedconfig\"}");
+    sim.run(5000);
+    CHECKEQUAL(sim.traffic.types[MESHSIM_MESHCOMMAND], 0);
+    CHECKEQUAL(countlogs(sim, "configdata", from, "\"cached\":true"), sim.nodecount());
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readmemory-control\"}");
+    sim.run(1000);
+    CHECKEQUAL(jsonnumber(sim.control().findlogs("controlmemorydata", from).back(), "LOGSTALLS"), stalls);
+
+    // Checking the cache for an unknown node does not add it to the registry
+    sim.within(sim.control(), [&]() {
+        uint16_t registered = NODEREGISTRYCOUNT;
+        CHECK(!isconfigcached(12345));
+        CHECKEQUAL(NODEREGISTRYCOUNT, registered);
+    });
+
+    // With more misses than CONFIGCACHE_MAXMISSES the command is broadcast once instead of sent to every node
+    sim.within(sim.control(), [&]() {CONFIGCACHECOUNT = 0;});
+    from = sim.control().logs.size();
+    sim.resettraffic();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readconfig-mesh\",\"ping\":\"missedconfig\"}");
+    sim.run(5000);
+    CHECKEQUAL(sim.traffic.types[MESHSIM_MESHCOMMAND], 1);
+    CHECKEQUAL(countlogs(sim, "configdata", from, "missedconfig"), sim.nodecount());
+}
+
+HOSTTEST(commands_are_answered_before_the_handshake_completes)
+{
+    MeshSimConfig config;
+    config.nodes = 4;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // A node that has not received the handshakeACK answers the origin of the command instead
+    sim.within(sim.node(0), [&]() {
+        MESHCONTROLNODE = 0;
+        handshaketask.disable();
+    });
+    sim.within(sim.control(), [&]() {CONFIGCACHECOUNT = 0;});
+    char line[160];
+    snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"readconfig-node\",\"node\":%u,\"ping\":\"earlyconfig\"}",
+             sim.node(0).nodeid);
+    size_t from = sim.control().logs.size();
+    sim.controllerline(line);
+    sim.run(2000);
+    CHECKEQUAL(countlogs(sim, "configdata", from, "earlyconfig"), 1);
+    sim.within(sim.control(), [&]() {CHECK(isconfigcached(sim.node(0).nodeid));});
+    sim.within(sim.node(0), [&]() {CHECKEQUAL(RELIABLEUNTRACKED, 0);});
+}
+
+HOSTTEST(readsensors_nodes_takes_a_full_node_list)
+{
+    MeshSimConfig config;
+    config.nodes = 8;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // A command with the largest node list of a fanout is longer than 255 characters and fits the line buffer
+    std::string line = "{\"type\":\"controlcommand\",\"command\":\"readsensors-nodes\",\"rate\":50,\"ping\":\"fulllist\",\"nodes\":[";
+    for (uint32_t i = 0; i < 64; i++) {
+        line += std::to_string(i < sim.nodecount() ? sim.node(i).nodeid : 3200000000u + i);
+        line += (i < 63) ? "," : "]}";
+    }
+    CHECK(line.size() > 700);
+    size_t from = sim.control().logs.size();
+    sim.controllerline(line);
+    sim.run(1000);
+
+    std::vector<std::string> batch = sim.control().findlogs("controlbatch", from);
+    CHECK(!batch.empty());
+    if (batch.empty()) {return;}
+    CHECKEQUAL(jsonnumber(batch[0], "targets"), 64);
+}
+
+HOSTTEST(group_tags_are_kept_apart_from_multicast_groups)
+{
+    // The first two sensor nodes belong to multicast group 5
+    MeshSimConfig config;
+    config.nodes = 8;
+    MeshSimulator sim(config);
+    sim.start([&](SimNode &node) {MESH_GROUP = (!node.control && node.index <= 2) ? 5 : 0;});
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // Tag two other nodes with group 7, which the multicast group of a node does not affect
+    char line[192];
+    snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"setgroup-control\",\"group\":7,\"nodes\":[%u,%u]}",
+             sim.node(2).nodeid, sim.node(3).nodeid);
+    sim.controllerline(line);
+    size_t from = sim.control().logs.size();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-nodes\",\"group\":7,\"ping\":\"tagged\"}");
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-group\",\"group\":5,\"ping\":\"mcast\"}");
+    sim.run(5000);
+    std::vector<std::string> batch = sim.control().findlogs("controlbatch", from);
+    CHECK(!batch.empty() && jsonnumber(batch[0], "targets") == 2);
+    CHECKEQUAL(countlogs(sim, "sensordata-batch", from, "\"ping\":\"mcast\""), 1);
+    CHECKEQUAL(countlogs(sim, "sensordata-batch", from, "\"expected\":2"), 2);
+
+    // A node that leaves its multicast group reports no group in its next handshake, which clears it
+    sim.within(sim.node(0), [&]() {
+        MESH_GROUP = 0;
+        MESHCONTROLNODE = 0;
+        handshaketask.restart();
+    });
+    sim.run(5000);
+    from = sim.control().logs.size();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-group\",\"group\":5,\"ping\":\"mcastleft\"}");
+    sim.run(5000);
+    CHECKEQUAL(countlogs(sim, "sensordata-batch", from, "\"expected\":1"), 1);
+}
+
+HOSTTEST(multicast_groups_are_not_truncated)
+{
+    // Nodes in a group that does not fit a byte and nodes in the group it would be truncated to
+    MeshSimConfig config;
+    config.nodes = 4;
+    MeshSimulator sim(config);
+    sim.start([&](SimNode &node) {MESH_GROUP = node.control ? 0 : (node.index <= 2) ? 300 : 44;});
+    CHECK(waitforhandshakes(sim, 30000));
+
+    size_t from = sim.control().logs.size();
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-group\",\"group\":300,\"ping\":\"widegroup\"}");
+    CHECK(sim.rununtil([&]() {return !sim.control().findlogs("sensordata-batch", from).empty();}, 5000));
+    std::vector<std::string> batch = sim.control().findlogs("sensordata-batch", from);
+    CHECK(!batch.empty());
+    if (batch.empty()) {return;}
+    CHECKEQUAL(jsonnumber(batch[0], "expected"), 2);
+    CHECKEQUAL(jsonnumber(batch[0], "received"), 2);
+    CHECKEQUAL(jsonnumber(batch[0], "late"), 0);
+}
+
+// A function that returns the reach object of a message type in a nodemetrics meshlog, or an empty string.
+static std::string trafficreaches(const std::string &log, const char *messagetype)
+{
+    std::string key = std::string("\"") + messagetype + "\":{";
+    size_t start = log.find(key);
+    if (start == std::string::npos) {return "";}
+    start += key.size();
+    return log.substr(start, log.find('}', start) - start);
+}
+
+HOSTTEST(traffic_is_counted_per_type_and_reach)
+{
+    MeshSimConfig config;
+    config.nodes = 8;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // The node receives a broadcast meshcommand along with the unicast ones of the handshake
+    sim.controllerline("{\"type\":\"controlcommand\",\"command\":\"readsensors-mesh\",\"ping\":\"broadcast\"}");
+    sim.run(2000);
+    char line[160];
+    snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"readtraffic-node\",\"node\":%u,\"ping\":\"traffic\"}",
+             sim.node(0).nodeid);
+    size_t from = sim.control().logs.size();
+    sim.controllerline(line);
+    sim.run(2000);
+
+    std::vector<std::string> metrics = sim.control().findlogs("nodemetrics", from);
+    CHECK(!metrics.empty());
+    if (metrics.empty()) {return;}
+    std::string meshcommand = trafficreaches(metrics[0], "meshcommand");
+    CHECK(meshcommand.find("\"unicast\":[0,0,") != std::string::npos);
+    CHECK(meshcommand.find("\"broadcast\":[0,0,1,") != std::string::npos);
+    CHECK(trafficreaches(metrics[0], "handshake").find("\"broadcast\":[1,") != std::string::npos);
+    CHECK(trafficreaches(metrics[0], "sensordata").find("\"unicast\":[1,") != std::string::npos);
+    CHECK(metrics[0].find("\"truncated\":false") != std::string::npos);
+}
+
+HOSTTEST(control_node_logs_messages_without_a_handler)
+{
+    MeshSimConfig config;
+    config.nodes = 4;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 30000));
+
+    // A meshcommand broadcast by the PINGER button of a sensor node reaches the control node log
+    size_t from = sim.control().logs.size();
+    sim.within(sim.node(0), [&]() {sendcommand_readsensors(0, "buttonping-1");});
+    sim.run(2000);
+    CHECKEQUAL(countlogs(sim, "messagerx", from, "\"rxtype\":\"meshcommand\""), 1);
+}
+
+HOSTTEST(full_history_is_read_under_loss)
+{
+    MeshSimConfig config;
+    config.nodes = 4;
+    config.loss = 0.1;
+    config.seed = 11;
+    MeshSimulator sim(config);
+    sim.start();
+    CHECK(waitforhandshakes(sim, 60000));
+
+    // Fill the history of the first node, which is sent in more chunks than the retransmit window holds
+    sim.within(sim.node(0), [&]() {HISTORYCOUNT = 128;});
+    char line[160];
+    snprintf(line, sizeof(line), "{\"type\":\"controlcommand\",\"command\":\"readhistory-node\",\"node\":%u,\"ping\":\"fullhistory\"}",
+             sim.node(0).nodeid);
+    size_t from = sim.control().logs.size();
+    sim.controllerline(line);
+    sim.run(30000);
+
+    // Every chunk arrives once, and none of them was sent without being tracked
+    std::vector<std::string> chunks = sim.control().findlogs("historydata", from);
+    CHECKEQUAL(chunks.size(), 13);
+    std::set<long long> numbers;
+    for (const std::string &chunk : chunks) {numbers.insert(jsonnumber(chunk, "chunk"));}
+    CHECKEQUAL(numbers.size(), 13);
+    CHECK(numbers.count(0) && numbers.count(12));
+    sim.within(sim.node(0), [&]() {CHECKEQUAL(RELIABLEUNTRACKED, 0);});
+}
+
+HOSTTEST_MAIN()